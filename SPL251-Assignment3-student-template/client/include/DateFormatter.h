@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ctime>
+#include <cstddef>
+
+// Formats epoch seconds as local time with integer arithmetic. localtime_r, which takes
+// the C library's timezone lock, only runs once per local day: it gives the day's UTC
+// offset and the formatted date prefixes, and every time inside that day is derived from
+// the seconds since local midnight. Days containing a DST change are not cached and go
+// through localtime_r each time, so the output always matches strftime.
+// Not synchronized, keep one per thread.
+class DateFormatter {
+private:
+    // [dayStart, dayEnd) in epoch seconds, empty until the first call
+    time_t dayStart;
+    time_t dayEnd;
+    // date prefixes of the last formatted day, written by strftime
+    char shortPrefix[16];  // "%d/%m/%y "
+    char longPrefix[24];   // "%Y-%m-%d "
+    size_t longPrefixSize;
+
+    // seconds since local midnight of epochTime, with the prefixes set to its date
+    long prepare(time_t epochTime);
+
+public:
+    static const size_t ShortSize = 14;      // "%d/%m/%y %H:%M"
+    static const size_t LongCapacity = 32;   // "%Y-%m-%d %H:%M:%S", wider for years past 9999
+
+    DateFormatter();
+
+    // write into out without a terminating '\0', formatLong returns the bytes written
+    void formatShort(time_t epochTime, char *out);
+    size_t formatLong(time_t epochTime, char *out);
+
+    // the calling thread's formatter
+    static DateFormatter &local();
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "event.h"
+#include "EventStore.h"
+#include "EventsFileReader.h"
+
+// Append-only log of received events, kept as numbered segment files in one directory.
+// Appends are buffered and written in batches, fsync runs once enough bytes or time have
+// piled up. Queries map the segments read-only and scan them, so they cover the whole
+// history on disk, retention does not apply to them, and reopening a directory needs no
+// replay: only the tail of the newest segment is checked for a torn record.
+//
+// Segment layout: an 8 byte magic, then records of
+//   u32 payload length, u32 FNV-1a of the payload,
+//   payload: i32 date_time, u8 Event::Flag bits, then channel, user, event name, city and
+//            description, each as u32 length + bytes.
+class EventLog {
+private:
+    static const size_t SegmentSize = 64 * 1024 * 1024;
+    static const size_t FlushSize = 64 * 1024;
+    static const size_t SyncBytes = 1024 * 1024;
+
+    mutable std::mutex mutex;
+    std::string directory;
+    int fd;
+    uint32_t activeSegment;
+    // bytes of the active segment including the buffered tail
+    size_t activeSize;
+    std::string buffer;
+    size_t unsyncedBytes;
+    std::chrono::steady_clock::time_point lastSync;
+    // sealed segments never change, their mappings are shared by all queries
+    std::map<uint32_t, std::shared_ptr<MappedFile>> sealed;
+
+    std::string segmentPath(uint32_t segment) const;
+    bool openSegment(uint32_t segment, size_t validSize);
+    bool flushBuffer();
+    bool syncNow();
+    bool roll();
+    // the segments as of now for a scan without the lock, nullptr if the log is closed
+    std::shared_ptr<std::vector<std::shared_ptr<MappedFile>>> mapSegments();
+
+public:
+    EventLog();
+    ~EventLog();
+    EventLog(const EventLog &) = delete;
+    EventLog &operator=(const EventLog &) = delete;
+
+    // creates the directory if needed and continues its newest segment
+    bool open(const std::string &directory);
+    void close();
+    bool isOpen() const;
+    std::string path() const;
+    size_t segmentCount() const;
+
+    bool append(const std::string &channel, const Event &event);
+    // writes the buffered records and fsyncs them
+    bool sync();
+    // user's logged rows of channel in (date_time, name) order that pass filter, descriptions
+    // point into the segment mappings held by snapshot.payload; false if nothing was logged
+    // for channel. With window only the rows outside it are taken, those the store does not
+    // answer for. Only matching rows are kept, the rest of the log stays in the mappings.
+    bool snapshotUser(const std::string &channel, const std::string &user, EventSnapshot &snapshot,
+                      const SummaryFilter &filter = SummaryFilter(), const StoreWindow *window = nullptr);
+    // date_time of the newest record of channel; false if nothing was logged for it
+    bool newestDateTime(const std::string &channel, int &dateTime);
+    // the Stats block of the same rows as snapshotUser, without keeping any of them
+    bool countsOf(const std::string &channel, const std::string &user, SummaryCounts &counts,
+                  const StoreWindow *window = nullptr);
+};
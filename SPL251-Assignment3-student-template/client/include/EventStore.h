@@ -0,0 +1,456 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <deque>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <climits>
+#include "event.h"
+#include "StringInterner.h"
+#include "TextIndex.h"
+#include "TimeBuckets.h"
+
+// Row ids kept sorted as a list of bounded sorted runs. Arrivals that are not older than
+// the newest row are appended to the last run, late ones are placed by binary search over
+// the runs and then inside one run, so an insert never moves more than one run.
+class OrderedRows {
+private:
+    static const size_t MaxRunSize = 256;
+    std::deque<std::vector<uint32_t>> runs;
+    size_t count;
+
+public:
+    OrderedRows() : runs(), count(0) {}
+
+    // less orders two rows, rows that compare equal keep their insertion order
+    template <typename Less>
+    void insert(uint32_t row, const Less &less) {
+        count++;
+        if (runs.empty() || !less(row, runs.back().back())) {
+            if (runs.empty() || runs.back().size() >= MaxRunSize) {
+                runs.emplace_back();
+                runs.back().reserve(MaxRunSize);
+            }
+            runs.back().push_back(row);
+            return;
+        }
+        // first run whose last row sorts after the new one
+        auto run = std::upper_bound(runs.begin(), runs.end(), row,
+                                    [&less](uint32_t value, const std::vector<uint32_t> &r) { return less(value, r.back()); });
+        run->insert(std::upper_bound(run->begin(), run->end(), row, less), row);
+        if (run->size() > 2 * MaxRunSize) {
+            std::vector<uint32_t> upper(run->begin() + MaxRunSize, run->end());
+            run->resize(MaxRunSize);
+            runs.insert(run + 1, std::move(upper));
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // first and last row in order, the set must not be empty
+    uint32_t front() const {
+        return runs.front().front();
+    }
+
+    uint32_t back() const {
+        return runs.back().back();
+    }
+
+    void popFront() {
+        count--;
+        runs.front().erase(runs.front().begin());
+        if (runs.front().empty()) {
+            runs.pop_front();
+        }
+    }
+
+    // Visits rows in order from the first one for which before is false, until visit returns
+    // false. before must hold for a prefix of the order, the start is found by binary search.
+    template <typename Before, typename Visit>
+    void forEachFrom(const Before &before, const Visit &visit) const {
+        auto run = std::partition_point(runs.begin(), runs.end(),
+                                        [&before](const std::vector<uint32_t> &r) { return before(r.back()); });
+        if (run == runs.end()) {
+            return;
+        }
+        for (auto row = std::partition_point(run->begin(), run->end(), before);;) {
+            for (; row != run->end(); ++row) {
+                if (!visit(*row)) {
+                    return;
+                }
+            }
+            if (++run == runs.end()) {
+                return;
+            }
+            row = run->begin();
+        }
+    }
+
+    // visits every row in order
+    template <typename Visit>
+    void forEach(const Visit &visit) const {
+        for (const std::vector<uint32_t> &run : runs) {
+            for (uint32_t row : run) {
+                visit(row);
+            }
+        }
+    }
+};
+
+// Monotonic allocator for event payload bytes of one channel. Bytes are bump-allocated
+// from large blocks and only given back all at once, on release() or destruction.
+class EventArena {
+private:
+    typedef std::vector<std::unique_ptr<char[]>> BlockList;
+    static const size_t BlockSize = 64 * 1024;
+    // shared so snapshots can keep filled blocks alive after release()
+    std::shared_ptr<BlockList> blocks;
+    char *current;
+    size_t remaining;
+    size_t reserved;
+
+public:
+    EventArena();
+    EventArena(const EventArena &) = delete;
+    EventArena &operator=(const EventArena &) = delete;
+    EventArena(EventArena &&) = default;
+    EventArena &operator=(EventArena &&) = default;
+
+    // copies value into the arena, the bytes stay valid until release()
+    const char *store(const std::string &value);
+    const char *store(const char *data, size_t size);
+    // keeps every block handed out so far alive, even across release(). Stored bytes are
+    // never written again, so a pinned reader needs no lock.
+    std::shared_ptr<const void> pin() const;
+    void release();
+    size_t bytesReserved() const;
+};
+
+// One stored event as seen by readers. Strings are interned ids, the description points
+// into the channel arena.
+struct EventRow {
+    int dateTime;
+    uint32_t user;
+    uint32_t name;
+    uint32_t city;
+    uint8_t flags;
+    const char *description;
+    uint32_t descriptionLength;
+
+    std::string descriptionText() const;
+};
+
+// The Stats block of a summary for one (channel, user), kept current as rows are added
+// and evicted.
+struct SummaryCounts {
+    size_t total;
+    size_t active;
+    size_t forcesArrival;
+
+    SummaryCounts() : total(0), active(0), forcesArrival(0) {}
+
+    void add(uint8_t flags) {
+        total++;
+        active += (flags & Event::ActiveFlag) ? 1 : 0;
+        forcesArrival += (flags & Event::ForcesArrivalFlag) ? 1 : 0;
+    }
+
+    void remove(uint8_t flags) {
+        total--;
+        active -= (flags & Event::ActiveFlag) ? 1 : 0;
+        forcesArrival -= (flags & Event::ForcesArrivalFlag) ? 1 : 0;
+    }
+
+    void add(const SummaryCounts &other) {
+        total += other.total;
+        active += other.active;
+        forcesArrival += other.forcesArrival;
+    }
+};
+
+// The rows of a channel the store answers for, in (date_time, name) order: those after the
+// newest row it ever evicted and not before its oldest live row. Rows outside were evicted,
+// never stored, or came back late behind an eviction; the event log answers for those.
+struct StoreWindow {
+    // no live rows, so none to answer for
+    bool empty;
+    int oldestDateTime;
+    uint32_t oldestName;
+    bool evicted;
+    int evictedDateTime;
+    uint32_t evictedName;
+
+    StoreWindow()
+        : empty(true), oldestDateTime(0), oldestName(StringInterner::EmptyId), evicted(false), evictedDateTime(0),
+          evictedName(StringInterner::EmptyId) {}
+
+    // true if a row with this key is one the store answers for
+    bool holds(int dateTime, uint32_t name) const {
+        return !empty && !keyLess(dateTime, name, oldestDateTime, oldestName) &&
+               (!evicted || keyLess(evictedDateTime, evictedName, dateTime, name));
+    }
+
+    // (date_time, name) order, names by their text
+    static bool keyLess(int dateTime, uint32_t name, int otherDateTime, uint32_t otherName) {
+        if (dateTime != otherDateTime) {
+            return dateTime < otherDateTime;
+        }
+        return name != otherName && internedString(name) < internedString(otherName);
+    }
+};
+
+// Optional restrictions on the rows of a summary, the defaults let every row through.
+struct SummaryFilter {
+    // inclusive date_time bounds
+    int from;
+    int to;
+    bool byCity;
+    std::string city;
+    // Event::Flag bits every row must have
+    uint8_t flags;
+    // seconds before the channel's newest date_time, -1 if not given; generateSummary turns
+    // it into from once it knows the channel
+    int last;
+
+    SummaryFilter() : from(INT_MIN), to(INT_MAX), byCity(false), city(), flags(0), last(-1) {}
+
+    bool matches(int dateTime, uint8_t rowFlags) const {
+        return dateTime >= from && dateTime <= to && (rowFlags & flags) == flags;
+    }
+
+    // true if every row matches
+    bool empty() const {
+        return from == INT_MIN && to == INT_MAX && !byCity && flags == 0 && last < 0;
+    }
+};
+
+// Rows copied out of a channel. It pins the arena blocks it points into, so it stays
+// valid and is read without any lock, even if the channel is dropped meanwhile.
+struct EventSnapshot {
+    std::vector<EventRow> rows;
+    // counts over rows, filled by user snapshots
+    SummaryCounts counts;
+    std::shared_ptr<const void> payload;
+
+    EventSnapshot() : rows(), counts(), payload() {}
+};
+
+// Events of one channel stored column by column, row i of every column is event i.
+// Scans only touch the columns they need. Evicted rows leave the orders at once and the
+// columns and the text index on the next compaction.
+class ChannelEvents {
+private:
+    // compaction waits until evicted rows outnumber live ones and at least this many
+    static const size_t CompactThreshold = 1024;
+    // set in the flags column on eviction, apart from the Event::Flag bits. Evicted rows stay
+    // in the text index posting lists until compaction, search() filters them out by this bit.
+    static const uint8_t EvictedFlag = 0x80;
+
+    std::vector<int> dateTimes;
+    // ids from the global StringInterner
+    std::vector<uint32_t> users;
+    std::vector<uint32_t> cities;
+    std::vector<uint32_t> names;
+    // Event::Flag bits
+    std::vector<uint8_t> flags;
+    // descriptions live in the channel's arena
+    std::vector<const char *> descriptionData;
+    std::vector<uint32_t> descriptionLengths;
+    EventArena arena;
+    // all rows and each user's rows in (date_time, name) order, maintained by add()
+    OrderedRows ordered;
+    std::unordered_map<uint32_t, OrderedRows> rowsByUser;
+    std::unordered_map<uint32_t, SummaryCounts> countsByUser;
+    // words of each row's event name and description
+    TextIndex text;
+    // every row ever added, overall and per city; evictions do not take rows back out
+    TimeBuckets trend;
+    std::unordered_map<uint32_t, TimeBuckets> trendByCity;
+    size_t evicted;
+    // newest key ever evicted, kept across compactions
+    bool anyEvicted;
+    int evictedDateTime;
+    uint32_t evictedName;
+    size_t liveDescriptionBytes;
+
+    bool rowLess(uint32_t a, uint32_t b) const;
+    void indexText(uint32_t row);
+    void compact();
+
+public:
+    // accounted cost of one row besides its description: the columns and both orders
+    static const size_t RowBytes = sizeof(int) + 3 * sizeof(uint32_t) + sizeof(uint8_t) + sizeof(const char *) +
+                                   sizeof(uint32_t) + 2 * sizeof(uint32_t);
+
+    ChannelEvents();
+    ChannelEvents(const ChannelEvents &) = delete;
+    ChannelEvents &operator=(const ChannelEvents &) = delete;
+    void add(const Event &event);
+    // copies row in, the description is copied into the channel's arena
+    void add(const EventRow &row);
+    // live rows
+    size_t size() const;
+    bool empty() const;
+    // live payload bytes, what the store's byte budget is checked against, see
+    // RetentionPolicy::maxBytes for what it leaves out
+    size_t bytesUsed() const;
+    // date_time of the oldest and newest live row, the channel must not be empty
+    int oldestDateTime() const;
+    int newestDateTime() const;
+    // drops the oldest live row
+    void evictOldest();
+    StoreWindow window() const;
+
+    int dateTime(size_t row) const;
+    uint32_t user(size_t row) const;
+    uint32_t city(size_t row) const;
+    uint32_t name(size_t row) const;
+    uint8_t flagsOf(size_t row) const;
+    std::string description(size_t row) const;
+    EventRow eventRow(uint32_t row) const;
+    std::shared_ptr<const void> pinPayload() const;
+
+    // columns still hold evicted rows until the next compaction
+    const std::vector<int> &dateTimeColumn() const;
+    const std::vector<uint32_t> &userColumn() const;
+    const std::vector<uint8_t> &flagColumn() const;
+    // rows reported by user in (date_time, name) order, nullptr if none
+    const OrderedRows *rowsOf(uint32_t user) const;
+    // counts of user's live rows, all zero if none
+    SummaryCounts countsOf(uint32_t user) const;
+    const OrderedRows &orderedRows() const;
+    // live rows matching query in (date_time, name) order
+    std::vector<uint32_t> search(const TextQuery &query) const;
+    const TextIndex &textIndex() const;
+    const TimeBuckets &trendBuckets() const;
+    // nullptr if no row of city was added
+    const TimeBuckets *cityTrendBuckets(uint32_t city) const;
+};
+
+// Limits the store enforces after every add, 0 disables a limit. Age is measured in
+// date_time seconds behind the newest event of the same channel, since reported events
+// carry their own timestamps rather than the time they arrived.
+struct RetentionPolicy {
+    size_t maxEventsPerChannel;
+    int maxAge;
+    // Caps the live payload only: RowBytes per live row plus its description. Not counted:
+    // arena blocks not yet reclaimed, evicted rows waiting for compaction, the text index,
+    // the trend counters and the global string table, so process memory can exceed it.
+    size_t maxBytes;
+
+    RetentionPolicy() : maxEventsPerChannel(0), maxAge(0), maxBytes(0) {}
+};
+
+struct RetentionStats {
+    size_t channels;
+    size_t events;
+    size_t bytes;
+    size_t evictedByCount;
+    size_t evictedByAge;
+    size_t evictedByBudget;
+};
+
+// All stored events, sharded by channel. Each channel has its own lock which is only held
+// to add rows or to copy a snapshot out, so writing a long summary never blocks the reader
+// thread and storing an event only ever waits for one short copy.
+class EventStore {
+private:
+    struct Shard {
+        std::mutex mutex;
+        ChannelEvents events;
+        // set once the shard left the map, later adds to it are not accounted
+        bool dropped;
+        Shard() : mutex(), events(), dropped(false) {}
+    };
+
+    // guards the map and the policy, never held while a shard is locked
+    mutable std::mutex channelsMutex;
+    // keyed by interned channel name
+    std::map<uint32_t, std::shared_ptr<Shard>> channels;
+    RetentionPolicy retention;
+    // totals over all shards, kept up to date under each shard's lock
+    std::atomic<size_t> totalEvents;
+    std::atomic<size_t> totalBytes;
+    std::atomic<size_t> evictedByCount;
+    std::atomic<size_t> evictedByAge;
+    std::atomic<size_t> evictedByBudget;
+
+    std::shared_ptr<Shard> findShard(const std::string &channel) const;
+    std::shared_ptr<Shard> shardFor(const std::string &channel, RetentionPolicy &policy);
+    std::vector<std::shared_ptr<Shard>> allShards() const;
+    // runs under the shard's lock, evicts by count and age and updates the totals
+    void trim(Shard &shard, const RetentionPolicy &policy, size_t eventsBefore, size_t bytesBefore);
+    // evicts oldest events store wide until the byte budget holds
+    void enforceBudget(size_t maxBytes);
+    // runs fill on the channel's events under its lock, then applies the retention policy
+    template <typename Fill>
+    void addTo(const std::string &channel, const Fill &fill);
+
+public:
+    // Events of one channel collected aside, e.g. while their file is still being read, and
+    // installed at once by replace() or add()
+    class Staged {
+    private:
+        friend class EventStore;
+        std::shared_ptr<Shard> shard;
+
+    public:
+        Staged();
+        void add(const Event &event);
+        size_t size() const;
+    };
+
+    EventStore();
+    EventStore(const EventStore &) = delete;
+    EventStore &operator=(const EventStore &) = delete;
+
+    void add(const std::string &channel, const Event &event);
+    void add(const std::string &channel, const std::vector<Event> &events);
+    void add(const std::string &channel, const std::vector<EventRow> &rows);
+    // replaces everything stored for channel with events; the new contents are built aside
+    // and swapped in, so readers see either the old or the new channel
+    void replace(const std::string &channel, const std::vector<Event> &events);
+    // the same for rows staged aside, staged is left empty
+    void replace(const std::string &channel, Staged &staged);
+    // copies the staged rows into channel
+    void add(const std::string &channel, const Staged &staged);
+    bool hasChannel(const std::string &channel) const;
+    // date_time of channel's newest live row; false if channel is not stored or empty
+    bool newestDateTime(const std::string &channel, int &dateTime) const;
+    std::vector<std::string> channelNames() const;
+    // every row of channel in (date_time, name) order; false if channel is not stored
+    bool snapshotChannel(const std::string &channel, EventSnapshot &snapshot) const;
+    // user's rows of channel in (date_time, name) order that pass filter; false if channel is
+    // not stored. The date range is a binary search into the user's order, the city and
+    // status checks compare interned ids and flag bits. window, if given, receives the
+    // channel's StoreWindow as of the snapshot and only rows inside it are taken.
+    bool snapshotUser(const std::string &channel, const std::string &user, EventSnapshot &snapshot,
+                      const SummaryFilter &filter = SummaryFilter(), StoreWindow *window = nullptr) const;
+    // rows of channel whose event name or description match query, in (date_time, name)
+    // order; false if channel is not stored. Answered from the posting lists of the query
+    // words, no stored event is scanned.
+    bool search(const std::string &channel, const TextQuery &query, EventSnapshot &snapshot) const;
+    // time bucketed counters of the events added to channel; false if channel is not stored
+    bool channelTrend(const std::string &channel, TimeBuckets &buckets) const;
+    // the counters of city merged over every channel; false if no channel has events there
+    bool cityTrend(const std::string &city, TimeBuckets &buckets) const;
+    // the user's Stats block without copying any row; false if channel is not stored. With
+    // window the same as for snapshotUser.
+    bool countsOf(const std::string &channel, const std::string &user, SummaryCounts &counts,
+                  StoreWindow *window = nullptr) const;
+    // releases everything stored for channel at once
+    void dropChannel(const std::string &channel);
+    void clear();
+    // applies the new limits to what is already stored as well
+    void setRetention(const RetentionPolicy &policy);
+    RetentionPolicy retentionPolicy() const;
+    RetentionStats retentionStats() const;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include "event.h"
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+class MappedFile {
+private:
+    const char *data_;
+    size_t size_;
+
+public:
+    MappedFile(const std::string &path);
+    virtual ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // false if the file could not be opened or is empty
+    bool isOpen() const;
+    const char *data() const;
+    size_t size() const;
+};
+
+// An events file that hands out each event together with the position of its JSON object,
+// and reads the event at such a position again for as long as it is open, so a caller can
+// keep positions instead of events. Files that match the events schema exactly
+// (channel_name, events[], event_name, city, date_time, description, general_information)
+// are read by a tokenizer that only knows that schema and keeps strings as views into the
+// mapping until an Event is built, anything else by nlohmann's SAX parser over the same bytes.
+class EventsFile {
+public:
+    typedef std::function<void(Event &event, size_t position)> Consumer;
+
+private:
+    MappedFile file;
+    // the bytes of a file that could not be mapped
+    std::string contents;
+    const char *begin;
+    const char *end;
+    std::string eventOwnerUser;
+    std::string channel_name;
+
+public:
+    EventsFile(const std::string &path, const std::string &eventOwnerUser);
+    EventsFile(const EventsFile &) = delete;
+    EventsFile &operator=(const EventsFile &) = delete;
+
+    // hands every event to consumer in file order and returns the channel name, throws
+    // std::runtime_error if the file is not a valid events file or repeats channel_name or
+    // events; events handed out before the error are not taken back
+    const std::string &read(const Consumer &consumer);
+    // the event read() handed out at position
+    Event eventAt(size_t position) const;
+};
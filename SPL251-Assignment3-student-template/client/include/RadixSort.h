@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "StringInterner.h"
+
+// Positions of keys in ascending key order, equal keys keeping their original order:
+// order[i] is the index of the i-th smallest key. Least significant digit radix sort over
+// 8 bit digits, skipping the digits every key shares; above a size threshold each pass
+// histograms and scatters in parallel chunks, on at most maxThreads threads started once
+// per sort (0 for one per core). Callers already running on a pool pass their share of
+// the cores, 1 to stay on their own thread. Small inputs use std::stable_sort.
+std::vector<uint32_t> radixOrder(const std::vector<uint64_t> &keys, size_t maxThreads = 0);
+
+// sort key of a signed date_time, in the high half so rank breaks ties
+inline uint64_t dateTimeKey(int dateTime, uint32_t rank) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(dateTime) ^ 0x80000000u) << 32) | rank;
+}
+
+// Summary order of count items, by date_time and then by event name, equal items keeping
+// their order. dateTime(i) and name(i) give item i's date_time and interned name; names
+// are ranked by string once per distinct name, so the sort itself never compares strings.
+template <typename DateTime, typename Name>
+std::vector<uint32_t> summaryOrder(size_t count, const DateTime &dateTime, const Name &name) {
+    std::unordered_map<uint32_t, uint32_t> ranks;
+    for (size_t i = 0; i < count; i++) {
+        ranks.emplace(name(i), 0);
+    }
+    std::vector<uint32_t> names;
+    names.reserve(ranks.size());
+    for (const auto &rank : ranks) {
+        names.push_back(rank.first);
+    }
+    std::sort(names.begin(), names.end(),
+              [](uint32_t a, uint32_t b) { return internedString(a) < internedString(b); });
+    for (size_t i = 0; i < names.size(); i++) {
+        ranks[names[i]] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<uint64_t> keys(count);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = dateTimeKey(dateTime(i), ranks[name(i)]);
+    }
+    return radixOrder(keys);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include "event.h"
+
+// Named conditions checked against every received event. A condition is compiled once into
+// a flat program of comparisons against interned ids, flag bits and date_time bounds, and
+// queries are grouped by channel, so an event only runs the programs of its own channel
+// and of the queries on every channel. Evaluating an event allocates nothing and adds
+// nothing to the string table; compiling only looks values up in it.
+//
+// Condition syntax: <channel|*> then clauses, all of which must hold, with "or" starting
+// another group of clauses:
+//   user=<name> city=<name> event=<name> text=<word> from=<date_time> to=<date_time>
+//   active forces inactive
+// Values with spaces are quoted, city="Liberty City". Channels match with or without the
+// leading '/'.
+class StandingQueries {
+public:
+    // query name, destination and the matching event, called on the receiving thread
+    typedef std::function<void(const std::string &query, const std::string &channel, const Event &event)> Sink;
+
+private:
+    struct Instruction {
+        enum Op : uint8_t { UserIs, CityIs, EventIs, HasWord, FlagsSet, FlagsClear, From, To };
+        Op op;
+        // index of the next group, where evaluation continues once a clause fails
+        uint16_t next;
+        // interned id of text, NoId if it was not interned when compiled
+        uint32_t id;
+        int number;
+        std::string text;
+
+        Instruction(Op op, uint32_t id, int number, const std::string &text)
+            : op(op), next(0), id(id), number(number), text(text) {}
+    };
+
+    struct Program {
+        std::string name;
+        std::string condition;
+        // without its leading '/', ignored for queries on every channel
+        std::string channel;
+        bool anyChannel;
+        std::vector<Instruction> code;
+
+        Program() : name(), condition(), channel(), anyChannel(false), code() {}
+        bool matches(const Event &event) const;
+    };
+
+    // replaced as a whole on every change, so evaluation works on an immutable copy
+    struct QuerySet {
+        // every channel is listed both with and without its leading '/', so a destination
+        // is looked up as it is
+        std::unordered_map<std::string, std::vector<std::shared_ptr<const Program>>> byChannel;
+        std::vector<std::shared_ptr<const Program>> onAnyChannel;
+        std::map<std::string, std::shared_ptr<const Program>> byName;
+
+        QuerySet() : byChannel(), onAnyChannel(), byName() {}
+    };
+
+    static const uint32_t NoId = UINT32_MAX;
+
+    // serializes add() and remove(); readers take queries with std::atomic_load and no lock
+    std::mutex mutex;
+    std::shared_ptr<const QuerySet> queries;
+    Sink sink;
+
+    void publish(std::unique_ptr<QuerySet> updated);
+
+public:
+    StandingQueries();
+    StandingQueries(const StandingQueries &) = delete;
+    StandingQueries &operator=(const StandingQueries &) = delete;
+
+    // not synchronized with evaluate(), set it before events arrive
+    void setSink(const Sink &sink);
+    // compiles condition and registers it as name, replacing a query of the same name;
+    // false with error set if condition does not compile
+    bool add(const std::string &name, const std::string &condition, std::string &error);
+    bool remove(const std::string &name);
+    // (name, condition) of every query
+    std::vector<std::pair<std::string, std::string>> list() const;
+    // runs the queries that can match channel on event and hands every match to the sink
+    size_t evaluate(const std::string &channel, const Event &event) const;
+};
@@ -14,23 +14,51 @@
 #include "ConnectionHandler.h"
 #include "CreateFrames.h"
 #include "../include/event.h"
+#include "../include/EventStore.h"
+#include "../include/EventLog.h"
+#include "../include/StoreSnapshot.h"
+#include "../include/SummaryWriter.h"
+#include "../include/StandingQueries.h"
 
 
+struct SummaryWatermark;
+
 class StompProtocol {
 private:
     ConnectionHandler connectionHandler;
     bool isConnected;
     std::map<std::string, int> subscriptions;
-    std::map<std::string, std::vector<Event>> Events;
+    // internally synchronized per channel
+    EventStore Events;
+    // received events are also appended here while a log directory is open
+    EventLog eventLog;
     int subscriptionID;
     int receiptID;
     CreateFrames frameCreator;
     std::string username;
     std::mutex connectionMutex;
     std::mutex subscriptionsMutex;
-    std::mutex eventMutex;
     std::atomic<bool> shouldStop;
     std::thread serverThread;
+    // checked against every received event, matches are logged as ALERT
+    StandingQueries standingQueries;
+    // received events keep their body and decode city, description and general information on first use
+    bool lazyEventParsing;
+    // declared last so queued summary writes finish before anything else is torn down
+    SummaryWriter summaryWriter;
+
+    // The store's rows inside its StoreWindow joined with the event log's rows outside it,
+    // such as evicted rows or a channel only logged before a restart. fromLog is set if the
+    // log contributed any.
+    bool snapshotUserRows(const std::string &channel, const std::string &user, EventSnapshot &snapshot,
+                          const SummaryFilter &filter, bool &fromLog);
+    // newest date_time of channel in the store, else in the event log
+    bool newestDateTime(const std::string &channel, int &dateTime);
+    void logSummaryWrite(const std::string &path, SummaryWriter::Status status, std::chrono::milliseconds elapsed);
+    // appends the rows after the watermark to the summary at path; false, without writing, if
+    // rows at or before it are missing from the file and it has to be rewritten
+    bool appendSummary(const std::string &path, const std::string &watermarkPath, SummaryWatermark &watermark,
+                       const std::vector<EventRow> &rows);
 
 public:
     StompProtocol(const std::string &host, int port);
@@ -42,11 +70,55 @@ public:
     void sendMessage(const std::string& destination, const std::string& messageBody);
     void unsubscribeFromTopic(const std::string& id);
     void disconnectFromServer();
+    void setLazyEventParsing(bool lazy);
     Event parseEvent(const std::string &message);
+    // headers already parsed from message, so the frame is not parsed twice
+    Event parseEvent(const std::string &message, const std::map<std::string, std::string> &headers);
     void handleReceivedMessage(const std::string &message);
     void reportEvents(const std::string &filePath);
+    // files are parsed in parallel and sent as one stream ordered by date_time
+    void reportEvents(const std::vector<std::string> &filePaths);
     static std::string epochToDate(time_t epochTime);
-    void generateSummary(const std::string &channelName, const std::string &user, const std::string &filePath);
+    // AsyncSummary hands the disk write to a background thread, which logs completion and
+    // duration. IncrementalSummary keeps a watermark next to the file and later only appends
+    // rows past it, updating the Stats block in place; rows older than the watermark that
+    // arrive late are left out until the next full summary. filter restricts the rows, the
+    // Stats block then counts the rows that passed.
+    enum SummaryMode { RewriteSummary, AsyncSummary, IncrementalSummary };
+    void generateSummary(const std::string &channelName, const std::string &user, const std::string &filePath,
+                         SummaryMode mode = RewriteSummary, const SummaryFilter &filter = SummaryFilter());
+    // one summary per (channel, user) in memory, written as <directory>/<channel>/<user>.txt
+    void generateAllSummaries(const std::string &directory);
+    // the summary file contents, Stats block included, with rows in snapshot order
+    static std::string renderSummary(const std::string &channelName, const std::string &user, const EventSnapshot &snapshot);
+    // the part of a summary before "Event Reports:", and the report lines of rows
+    static std::string renderSummaryHeader(const std::string &channelName, const std::string &user, const SummaryCounts &counts);
+    static void renderSummaryRows(std::string &out, std::vector<EventRow>::const_iterator first,
+                                  std::vector<EventRow>::const_iterator last);
+    // logs the Stats block of a summary from the running counters, without building the report;
+    // channels not in memory are counted from the event log and the line says so
+    void printStats(const std::string &channelName, const std::string &user);
+    // logs the stored events of a channel whose event name or description match query, with
+    // the same channel name fallback as summaries; query is the text the user typed
+    void searchEvents(const std::string &channelName, const TextQuery &query, const std::string &queryText);
+    // logs event counts, rates and active counts over each window, a number of buckets of one
+    // resolution ending at the newest event of the channel (with the summary name fallback)
+    // or of the city across channels
+    void printTrend(bool byCity, const std::string &name,
+                    const std::vector<std::pair<TimeBuckets::Resolution, size_t>> &windows);
+    // standing queries, see StandingQueries for the condition syntax
+    bool addWatch(const std::string &name, const std::string &condition);
+    void removeWatch(const std::string &name);
+    void listWatches();
+    // summaries and stats of channels that are not in memory are read from the log on disk
+    bool openEventLog(const std::string &directory);
+    void closeEventLog();
+    // stored events to and from a binary snapshot file, restore replaces what is stored
+    void saveSnapshot(const std::string &filePath);
+    void restoreSnapshot(const std::string &filePath);
+    void setRetention(const RetentionPolicy &policy);
+    // logs the limits, what is stored and how much was evicted so far
+    void logRetentionStats();
     void runServerMessage();
 };
 
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include "EventStore.h"
+
+// Binary snapshot of an EventStore, version 1, native byte order:
+//   header:      8 byte magic, u32 version, u32 string count, u32 channel count
+//   strings:     u32 length + bytes each, referenced below by their index
+//   per channel: u32 channel string, u32 row count, u64 description bytes,
+//                i32 date_time[rows], u32 user[rows], u32 city[rows], u32 name[rows],
+//                u32 description length[rows], u8 flags[rows] padded to 4 bytes,
+//                the descriptions back to back
+// Rows are written in (date_time, name) order, so restoring rebuilds every order on the
+// append fast path. Restore reads the file through a read-only mapping.
+
+// writes through SummaryWriter::replace, so a crash never leaves half a snapshot
+bool saveStoreSnapshot(const EventStore &store, const std::string &path, size_t &events);
+// replaces the store's contents; false, leaving the store untouched, if the file is
+// missing, of another version or malformed
+bool restoreStoreSnapshot(EventStore &store, const std::string &path, size_t &events);
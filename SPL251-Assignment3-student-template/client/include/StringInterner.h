@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+
+// Process wide string interning for the values that repeat across events (users, cities,
+// channels, event names, general information keys). Ids are dense and never reused, and
+// the interned strings never move, so references from lookup() stay valid for the whole run.
+// Nothing is ever released: the table grows with the distinct values seen and is not part
+// of the store's byte budget, so values typed by the user are looked up with find() rather
+// than interned. find() and intern() of a known value share a reader lock, only a new value
+// takes it exclusively; lookup() takes no lock.
+class StringInterner {
+private:
+    static const uint32_t ChunkBits = 12;
+    static const uint32_t ChunkSize = 1u << ChunkBits;
+    static const uint32_t MaxChunks = 1u << 12;
+
+    mutable std::shared_timed_mutex mutex;
+    std::unordered_map<std::string, uint32_t> ids;
+    // strings live in fixed size chunks that are only ever appended to
+    std::atomic<std::string *> chunks[MaxChunks];
+    uint32_t count;
+
+    StringInterner();
+
+public:
+    // id of "", interned first
+    static const uint32_t EmptyId = 0;
+
+    ~StringInterner();
+    StringInterner(const StringInterner &) = delete;
+    StringInterner &operator=(const StringInterner &) = delete;
+
+    static StringInterner &instance();
+
+    uint32_t intern(const std::string &value);
+    // false if value was never interned
+    bool find(const std::string &value, uint32_t &id) const;
+    const std::string &lookup(uint32_t id) const;
+    size_t size() const;
+};
+
+// shorthands for the global table
+inline uint32_t internString(const std::string &value) {
+    return StringInterner::instance().intern(value);
+}
+
+inline const std::string &internedString(uint32_t id) {
+    return StringInterner::instance().lookup(id);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+// Writes rendered summaries with a single pwrite into a file preallocated to the final
+// size. Jobs handed to writeAsync run in order on one background thread, started on first
+// use; their completion callback runs on that thread as well.
+class SummaryWriter {
+public:
+    enum Status { Written, OpenFailed, WriteFailed };
+    typedef std::function<void(const std::string &path, Status status, std::chrono::milliseconds elapsed)> Completion;
+
+    SummaryWriter();
+    // waits for every queued job
+    ~SummaryWriter();
+    SummaryWriter(const SummaryWriter &) = delete;
+    SummaryWriter &operator=(const SummaryWriter &) = delete;
+
+    static Status write(const std::string &path, const std::string &contents);
+    // Replaces the first headerSize bytes of an existing file with header and appends tail.
+    // A header of the same size is written in place after the tail; a crash in between
+    // leaves the file longer than its watermark says, so the next incremental summary
+    // rewrites it. Otherwise the new file is written aside and renamed over the old one.
+    static Status update(const std::string &path, size_t headerSize, const std::string &header, const std::string &tail);
+    // Writes contents to path.tmp, fsyncs it and renames it over path, then fsyncs the
+    // directory: after a crash path holds either the old or the new contents whole.
+    static Status replace(const std::string &path, const std::string &contents);
+    void writeAsync(const std::string &path, std::string contents, const Completion &done);
+
+private:
+    struct Job {
+        std::string path;
+        std::string contents;
+        Completion done;
+    };
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> jobs;
+    bool stopping;
+    std::thread worker;
+
+    void run();
+};
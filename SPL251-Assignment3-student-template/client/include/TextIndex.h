@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Increasing row ids stored as varint encoded gaps, a row added twice in a row is kept once
+class PostingList {
+private:
+    std::vector<uint8_t> bytes;
+    uint32_t last;
+    uint32_t count;
+
+public:
+    PostingList() : bytes(), last(0), count(0) {}
+
+    // row must not be smaller than the last one added
+    void add(uint32_t row);
+    size_t size() const;
+    size_t bytesUsed() const;
+    void decode(std::vector<uint32_t> &rows) const;
+};
+
+// Any of the groups, every term of a group: {{"red", "car"}, {"truck"}} is red AND car OR truck
+typedef std::vector<std::vector<std::string>> TextQuery;
+
+// Inverted index from the words of event names and descriptions to the rows holding them.
+// A word is a maximal run of word bytes: ASCII letters, lowercased, ASCII digits, and every
+// byte from 0x80 up, so non-ASCII characters are part of words and are matched byte for
+// byte without case folding. Anything else separates words: "AB-123" yields "ab" and "123".
+class TextIndex {
+private:
+    std::unordered_map<std::string, PostingList> terms;
+    // the folded word add() looks up, its capacity is kept so indexing allocates only for
+    // terms not seen before
+    std::string word;
+
+    // rows holding every word of group's terms, in increasing order
+    std::vector<uint32_t> matchAll(const std::vector<std::string> &group) const;
+
+public:
+    TextIndex() : terms(), word() {}
+
+    static bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+    }
+
+    // a word byte as it is indexed
+    static char foldWordByte(unsigned char c) {
+        return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+
+    // calls visit(word) for each word of text, folded into word, which is overwritten each time
+    template <typename Visit>
+    static void forEachWord(const char *text, size_t size, std::string &word, Visit visit) {
+        size_t i = 0;
+        while (i < size) {
+            for (; i < size && !isWordByte(static_cast<unsigned char>(text[i])); i++) {
+            }
+            if (i == size) {
+                break;
+            }
+            word.clear();
+            for (; i < size && isWordByte(static_cast<unsigned char>(text[i])); i++) {
+                word.push_back(foldWordByte(static_cast<unsigned char>(text[i])));
+            }
+            visit(static_cast<const std::string &>(word));
+        }
+    }
+
+    static void tokenize(const char *text, size_t size, std::vector<std::string> &words);
+
+    // rows must be added in increasing order
+    void add(uint32_t row, const char *text, size_t size);
+    // matching rows in increasing order; a term that splits into several words needs all of them
+    std::vector<uint32_t> match(const TextQuery &query) const;
+    size_t termCount() const;
+    size_t bytesUsed() const;
+    void clear();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Events and active events per window of a TimeBuckets series
+struct TrendCounts {
+    size_t events;
+    size_t active;
+
+    TrendCounts() : events(0), active(0) {}
+};
+
+// Event counters bucketed by date_time at minute, hour and day resolution, each a ring of
+// the most recent buckets. Buckets are aligned to epoch multiples of their width, days in
+// UTC. Counting happens at insert, so windows are answered from the buckets alone.
+// Events older than a ring reaches back are left out of that resolution.
+class TimeBuckets {
+public:
+    enum Resolution { Minute, Hour, Day, ResolutionCount };
+
+private:
+    struct Bucket {
+        // date_time / width of the bucket's events, INT32_MIN while unused
+        int32_t index;
+        uint32_t events;
+        uint32_t active;
+
+        Bucket() : index(INT32_MIN), events(0), active(0) {}
+    };
+
+    std::vector<Bucket> rings[ResolutionCount];
+    int newestDateTime;
+    bool hasEvents;
+
+    static int32_t bucketIndex(int dateTime, Resolution resolution);
+
+public:
+    TimeBuckets();
+
+    // seconds per bucket and buckets kept
+    static int width(Resolution resolution);
+    static size_t capacity(Resolution resolution);
+
+    void add(int dateTime, uint8_t flags);
+    // adds other's buckets, as if its events had been added here as well
+    void merge(const TimeBuckets &other);
+    bool empty() const;
+    // date_time of the newest event added, the series must not be empty
+    int newest() const;
+    // the last count buckets of resolution, up to and including the one holding end;
+    // count is capped at capacity(resolution)
+    TrendCounts window(Resolution resolution, size_t count, int end) const;
+};
@@ -4,47 +4,132 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <functional>
+#include <cstdint>
+
+// one general_information value, parsed once into its natural type
+struct GeneralInfoValue {
+    enum Type { BoolValue, IntegerValue, StringValue };
+    Type type;
+    bool boolean;
+    long long integer;
+    // only set for StringValue
+    std::string text;
+
+    GeneralInfoValue() : type(StringValue), boolean(false), integer(0), text() {}
+    GeneralInfoValue(Type type, bool boolean, long long integer, const std::string &text)
+        : type(type), boolean(boolean), integer(integer), text(text) {}
+
+    static GeneralInfoValue parse(const std::string &value);
+    // the value as it is written in a message body
+    std::string toString() const;
+};
 
 class Event
 {
+public:
+    // bits of flags(), set once when the event is built
+    enum Flag : uint8_t {
+        ActiveFlag = 1,
+        ForcesArrivalFlag = 2
+    };
+
 private:
-    // name of channel
-    std::string channel_name;
-    // city of the event 
-    std::string city;
+    // position of a field inside raw_body
+    struct FieldSpan {
+        size_t offset;
+        size_t length;
+    };
+
+    // fields of a received event that are still only a FieldSpan, see pending
+    enum PendingField : uint8_t {
+        PendingCity = 1,
+        PendingDescription = 2,
+        PendingGeneralInformation = 4
+    };
+
+    // name of channel (interned)
+    uint32_t channel_name;
+    // city of the event (interned)
+    mutable uint32_t city;
     // name of the event
     std::string name;
     // time of the event in seconds
     int date_time;
     // description of the event
-    std::string description;
-    // map of all the general information
-    std::map<std::string, std::string> general_information;
-    std::string eventOwnerUser;
+    mutable std::string description;
+    // all the general information, keyed by interned key
+    mutable std::map<uint32_t, GeneralInfoValue> general_information;
+    // active / forces arrival at scene, see Flag
+    uint8_t flags;
+    // interned
+    uint32_t eventOwnerUser;
+
+    // received events keep their MESSAGE frame and decode the PendingField fields from it
+    // on first access; empty for events built any other way
+    std::string raw_body;
+    FieldSpan city_span;
+    FieldSpan description_span;
+    FieldSpan general_information_span;
+    mutable uint8_t pending;
+
+    void computeFlags();
+    std::string spanText(const FieldSpan &span) const;
+    // the one "key:value" the general information line of a received body may hold
+    bool extraGeneralInformation(std::string &key, std::string &value) const;
+    void decodeCity() const;
+    void decodeDescription() const;
+    void decodeGeneralInformation() const;
 
 public:
     Event(std::string channel_name, std::string city, std::string name, int date_time, std::string description, std::map<std::string, std::string> general_information);
     Event(const std::string & frame_body);
+    // A received MESSAGE frame, read the way the receive path always has: the first line of
+    // each field, active and forces_arrival_at_scene from "active:true" and
+    // "forces_arrival_at_scene:true" anywhere in it. The name, date_time and flags are decoded
+    // here; with lazy the city, description and general information are decoded on first
+    // access, which is not synchronized, so share such events under a lock.
+    Event(std::string received_frame, const std::string &channel_name, int date_time, bool lazy);
     virtual ~Event();
     void setEventOwnerUser(std::string setEventOwnerUser);
+    // for events read before the channel name of their file was known
+    void setChannelName(const std::string &channel_name);
     const std::string &getEventOwnerUser() const;
     const std::string &get_channel_name() const;
     const std::string &get_city() const;
+    // interned ids of the fields above
+    uint32_t getEventOwnerUserId() const;
+    uint32_t get_channel_name_id() const;
+    uint32_t get_city_id() const;
     const std::string &get_description() const;
+    // the description bytes without decoding them, valid as long as the event is unchanged
+    const char *get_description_data() const;
+    size_t get_description_size() const;
     bool isActive() const;
     bool forcesArrivalAtScene() const;
+    uint8_t get_flags() const;
     int getCurrentTime() const;
     std::string toString() const;
     const std::string &get_name() const;
     int get_date_time() const;
-    const std::map<std::string, std::string> &get_general_information() const;
+    std::map<std::string, std::string> get_general_information() const;
+    const std::map<uint32_t, GeneralInfoValue> &get_typed_general_information() const;
 };
 
 // an object that holds the names of the teams and a vector of events, to be returned by the parseEventsFile function
 struct names_and_events {
     std::string channel_name;
     std::vector<Event> events;
+
+    names_and_events() : channel_name(), events() {}
+    names_and_events(const std::string &channel_name, const std::vector<Event> &events)
+        : channel_name(channel_name), events(events) {}
 };
 
 // function that parses the json file and returns a names_and_events object
 names_and_events parseEventsFile(std::string json_path, const std::string& eventOwnerUser);
+
+// streaming variant: each event is handed to consumer as soon as its JSON object is read,
+// returns the channel name of the file
+std::string parseEventsFile(const std::string &json_path, const std::string &eventOwnerUser,
+                            const std::function<void(Event &)> &consumer);
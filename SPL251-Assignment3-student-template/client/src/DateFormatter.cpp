@@ -0,0 +1,64 @@
+#include "../include/DateFormatter.h"
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const long SecondsPerDay = 24 * 60 * 60;
+
+void putTwoDigits(char *out, long value) {
+    out[0] = static_cast<char>('0' + value / 10);
+    out[1] = static_cast<char>('0' + value % 10);
+}
+
+} // namespace
+
+DateFormatter::DateFormatter() : dayStart(0), dayEnd(0), shortPrefix(), longPrefix(), longPrefixSize(0) {}
+
+long DateFormatter::prepare(time_t epochTime) {
+    if (epochTime >= dayStart && epochTime < dayEnd) {
+        return static_cast<long>(epochTime - dayStart);
+    }
+    struct tm local;
+    localtime_r(&epochTime, &local);
+    long seconds = local.tm_hour * 3600L + local.tm_min * 60L + local.tm_sec;
+    strftime(shortPrefix, sizeof(shortPrefix), "%d/%m/%y ", &local);
+    longPrefixSize = strftime(longPrefix, sizeof(longPrefix), "%Y-%m-%d ", &local);
+
+    // the day is cached only if it starts at 00:00:00 and ends at 23:59:59 on one UTC offset
+    time_t start = epochTime - seconds;
+    time_t last = start + SecondsPerDay - 1;
+    struct tm edge;
+    bool steady = localtime_r(&start, &edge) != nullptr && edge.tm_gmtoff == local.tm_gmtoff && edge.tm_hour == 0 &&
+                  edge.tm_min == 0 && edge.tm_sec == 0 && localtime_r(&last, &edge) != nullptr &&
+                  edge.tm_gmtoff == local.tm_gmtoff && edge.tm_hour == 23 && edge.tm_min == 59 && edge.tm_sec == 59;
+    dayStart = steady ? start : 0;
+    dayEnd = steady ? start + SecondsPerDay : 0;
+    return seconds;
+}
+
+void DateFormatter::formatShort(time_t epochTime, char *out) {
+    long seconds = prepare(epochTime);
+    memcpy(out, shortPrefix, 9);
+    putTwoDigits(out + 9, seconds / 3600);
+    out[11] = ':';
+    putTwoDigits(out + 12, seconds / 60 % 60);
+}
+
+size_t DateFormatter::formatLong(time_t epochTime, char *out) {
+    long seconds = prepare(epochTime);
+    memcpy(out, longPrefix, longPrefixSize);
+    char *time = out + longPrefixSize;
+    putTwoDigits(time, seconds / 3600);
+    time[2] = ':';
+    putTwoDigits(time + 3, seconds / 60 % 60);
+    time[5] = ':';
+    putTwoDigits(time + 6, seconds % 60);
+    return longPrefixSize + 8;
+}
+
+DateFormatter &DateFormatter::local() {
+    static thread_local DateFormatter formatter;
+    return formatter;
+}
@@ -0,0 +1,485 @@
+#include "../include/EventLog.h"
+#include "../include/RadixSort.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+const char SegmentMagic[8] = {'E', 'V', 'L', 'O', 'G', '0', '1', '\n'};
+const size_t RecordHeaderSize = 2 * sizeof(uint32_t);
+const std::chrono::seconds SyncInterval(1);
+
+struct TextView {
+    const char *data;
+    uint32_t size;
+
+    bool equals(const std::string &value) const {
+        return size == value.size() && memcmp(data, value.data(), size) == 0;
+    }
+
+    // byte order, as std::string compares
+    int compare(const std::string &value) const {
+        int order = memcmp(data, value.data(), std::min<size_t>(size, value.size()));
+        if (order != 0) {
+            return order;
+        }
+        return size < value.size() ? -1 : (size > value.size() ? 1 : 0);
+    }
+};
+
+struct RecordView {
+    int dateTime;
+    uint8_t flags;
+    TextView channel;
+    TextView user;
+    TextView name;
+    TextView city;
+    TextView description;
+};
+
+uint32_t fnv1a(const char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void putU32(std::string &out, uint32_t value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void putText(std::string &out, const char *data, size_t size) {
+    putU32(out, static_cast<uint32_t>(size));
+    out.append(data, size);
+}
+
+void putText(std::string &out, const std::string &value) {
+    putText(out, value.data(), value.size());
+}
+
+bool readText(const char *&cursor, const char *end, TextView &text) {
+    if (static_cast<size_t>(end - cursor) < sizeof(uint32_t)) {
+        return false;
+    }
+    memcpy(&text.size, cursor, sizeof(uint32_t));
+    cursor += sizeof(uint32_t);
+    if (static_cast<size_t>(end - cursor) < text.size) {
+        return false;
+    }
+    text.data = cursor;
+    cursor += text.size;
+    return true;
+}
+
+// decodes the record at offset and moves offset past it, false on a torn or corrupt record
+bool readRecord(const char *data, size_t size, size_t &offset, RecordView &record) {
+    if (size - offset < RecordHeaderSize) {
+        return false;
+    }
+    uint32_t length, checksum;
+    memcpy(&length, data + offset, sizeof(uint32_t));
+    memcpy(&checksum, data + offset + sizeof(uint32_t), sizeof(uint32_t));
+    const char *cursor = data + offset + RecordHeaderSize;
+    if (static_cast<size_t>(data + size - cursor) < length || fnv1a(cursor, length) != checksum) {
+        return false;
+    }
+    const char *end = cursor + length;
+    if (static_cast<size_t>(end - cursor) < sizeof(int32_t) + 1) {
+        return false;
+    }
+    int32_t dateTime;
+    memcpy(&dateTime, cursor, sizeof(int32_t));
+    record.dateTime = dateTime;
+    record.flags = static_cast<uint8_t>(cursor[sizeof(int32_t)]);
+    cursor += sizeof(int32_t) + 1;
+    if (!readText(cursor, end, record.channel) || !readText(cursor, end, record.user) ||
+        !readText(cursor, end, record.name) || !readText(cursor, end, record.city) ||
+        !readText(cursor, end, record.description) || cursor != end) {
+        return false;
+    }
+    offset += RecordHeaderSize + length;
+    return true;
+}
+
+// Interned ids of record fields, each distinct value is interned once per scan and later
+// records are matched against it by their bytes, without the interner's lock
+class TextIds {
+private:
+    std::unordered_map<uint32_t, std::vector<std::pair<TextView, uint32_t>>> byHash;
+
+public:
+    TextIds() : byHash() {}
+
+    uint32_t idOf(const TextView &text) {
+        std::vector<std::pair<TextView, uint32_t>> &candidates = byHash[fnv1a(text.data, text.size)];
+        for (const auto &candidate : candidates) {
+            if (candidate.first.size == text.size && memcmp(candidate.first.data, text.data, text.size) == 0) {
+                return candidate.second;
+            }
+        }
+        uint32_t id = internString(std::string(text.data, text.size));
+        candidates.emplace_back(text, id);
+        return id;
+    }
+};
+
+bool hasMagic(const MappedFile &segment) {
+    return segment.isOpen() && segment.size() >= sizeof(SegmentMagic) &&
+           memcmp(segment.data(), SegmentMagic, sizeof(SegmentMagic)) == 0;
+}
+
+// size of the valid prefix of a segment, 0 if it does not start with the magic
+size_t validSegmentSize(const MappedFile &segment) {
+    if (!hasMagic(segment)) {
+        return 0;
+    }
+    size_t offset = sizeof(SegmentMagic);
+    RecordView record;
+    while (readRecord(segment.data(), segment.size(), offset, record)) {
+    }
+    return offset;
+}
+
+bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Picks the records of a channel outside a StoreWindow, the ones the store does not answer for
+class WindowCheck {
+private:
+    const StoreWindow *window;
+    std::string oldestName;
+    std::string evictedName;
+
+    // record key against (dateTime, name)
+    static int compare(const RecordView &record, int dateTime, const std::string &name) {
+        if (record.dateTime != dateTime) {
+            return record.dateTime < dateTime ? -1 : 1;
+        }
+        return record.name.compare(name);
+    }
+
+public:
+    WindowCheck(const StoreWindow *window)
+        : window(window), oldestName(window != nullptr ? internedString(window->oldestName) : std::string()),
+          evictedName(window != nullptr ? internedString(window->evictedName) : std::string()) {}
+    WindowCheck(const WindowCheck &) = delete;
+    WindowCheck &operator=(const WindowCheck &) = delete;
+
+    bool outside(const RecordView &record) const {
+        return window == nullptr || window->empty || compare(record, window->oldestDateTime, oldestName) < 0 ||
+               (window->evicted && compare(record, window->evictedDateTime, evictedName) <= 0);
+    }
+};
+
+// calls visit on every record of channel in log order, true if there was any
+template <typename Visit>
+bool scanChannel(const std::vector<std::shared_ptr<MappedFile>> &segments, const std::string &channel,
+                 const Visit &visit) {
+    bool channelFound = false;
+    for (const std::shared_ptr<MappedFile> &segment : segments) {
+        if (!hasMagic(*segment)) {
+            continue;
+        }
+        size_t offset = sizeof(SegmentMagic);
+        RecordView record;
+        while (readRecord(segment->data(), segment->size(), offset, record)) {
+            if (record.channel.equals(channel)) {
+                channelFound = true;
+                visit(record);
+            }
+        }
+    }
+    return channelFound;
+}
+
+// calls visit on every record of channel by user that passes filter and window, true if
+// anything was logged for channel
+template <typename Visit>
+bool scanUser(const std::vector<std::shared_ptr<MappedFile>> &segments, const std::string &channel,
+              const std::string &user, const SummaryFilter &filter, const StoreWindow *window, const Visit &visit) {
+    WindowCheck check(window);
+    return scanChannel(segments, channel, [&](const RecordView &record) {
+        if (check.outside(record) && record.user.equals(user) && filter.matches(record.dateTime, record.flags) &&
+            (!filter.byCity || record.city.equals(filter.city))) {
+            visit(record);
+        }
+    });
+}
+
+} // namespace
+
+EventLog::EventLog()
+    : mutex(), directory(), fd(-1), activeSegment(0), activeSize(0), buffer(), unsyncedBytes(0),
+      lastSync(std::chrono::steady_clock::now()), sealed() {}
+
+EventLog::~EventLog() {
+    close();
+}
+
+std::string EventLog::segmentPath(uint32_t segment) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/segment-%08u.log", segment);
+    return directory + name;
+}
+
+// opens segment for appending, cutting it back to validSize; a new segment gets the magic
+bool EventLog::openSegment(uint32_t segment, size_t validSize) {
+    std::string path = segmentPath(segment);
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (validSize == 0) {
+        if (::ftruncate(fd, 0) != 0 || !writeAll(fd, SegmentMagic, sizeof(SegmentMagic))) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        validSize = sizeof(SegmentMagic);
+    } else if (::ftruncate(fd, static_cast<off_t>(validSize)) != 0) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    ::lseek(fd, static_cast<off_t>(validSize), SEEK_SET);
+    activeSegment = segment;
+    activeSize = validSize;
+    return true;
+}
+
+bool EventLog::open(const std::string &path) {
+    close();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    DIR *dir = ::opendir(path.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    std::vector<uint32_t> segments;
+    while (struct dirent *entry = ::readdir(dir)) {
+        unsigned segment;
+        char tail;
+        if (sscanf(entry->d_name, "segment-%8u.lo%c", &segment, &tail) == 2 && tail == 'g') {
+            segments.push_back(segment);
+        }
+    }
+    ::closedir(dir);
+    std::sort(segments.begin(), segments.end());
+
+    directory = path;
+    size_t validSize = 0;
+    uint32_t active = 1;
+    if (!segments.empty()) {
+        active = segments.back();
+        validSize = validSegmentSize(MappedFile(segmentPath(active)));
+        segments.pop_back();
+    }
+    for (uint32_t segment : segments) {
+        sealed[segment] = std::make_shared<MappedFile>(segmentPath(segment));
+    }
+    if (!openSegment(active, validSize)) {
+        sealed.clear();
+        directory.clear();
+        return false;
+    }
+    lastSync = std::chrono::steady_clock::now();
+    return true;
+}
+
+void EventLog::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0) {
+        return;
+    }
+    syncNow();
+    ::close(fd);
+    fd = -1;
+    sealed.clear();
+    directory.clear();
+}
+
+bool EventLog::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fd >= 0;
+}
+
+std::string EventLog::path() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return directory;
+}
+
+size_t EventLog::segmentCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fd < 0 ? 0 : sealed.size() + 1;
+}
+
+bool EventLog::flushBuffer() {
+    if (buffer.empty()) {
+        return true;
+    }
+    bool written = writeAll(fd, buffer.data(), buffer.size());
+    unsyncedBytes += buffer.size();
+    buffer.clear();
+    return written;
+}
+
+bool EventLog::syncNow() {
+    bool flushed = flushBuffer();
+    if (unsyncedBytes > 0) {
+        flushed = ::fdatasync(fd) == 0 && flushed;
+        unsyncedBytes = 0;
+    }
+    lastSync = std::chrono::steady_clock::now();
+    return flushed;
+}
+
+// seals the active segment and starts the next one
+bool EventLog::roll() {
+    bool synced = syncNow();
+    ::close(fd);
+    fd = -1;
+    sealed[activeSegment] = std::make_shared<MappedFile>(segmentPath(activeSegment));
+    return openSegment(activeSegment + 1, 0) && synced;
+}
+
+bool EventLog::append(const std::string &channel, const Event &event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0) {
+        return false;
+    }
+    size_t start = buffer.size();
+    buffer.append(RecordHeaderSize, '\0');
+    int32_t dateTime = event.get_date_time();
+    buffer.append(reinterpret_cast<const char *>(&dateTime), sizeof(dateTime));
+    buffer.push_back(static_cast<char>(event.get_flags()));
+    putText(buffer, channel);
+    putText(buffer, event.getEventOwnerUser());
+    putText(buffer, event.get_name());
+    putText(buffer, event.get_city());
+    putText(buffer, event.get_description_data(), event.get_description_size());
+    uint32_t length = static_cast<uint32_t>(buffer.size() - start - RecordHeaderSize);
+    uint32_t checksum = fnv1a(buffer.data() + start + RecordHeaderSize, length);
+    memcpy(&buffer[start], &length, sizeof(uint32_t));
+    memcpy(&buffer[start + sizeof(uint32_t)], &checksum, sizeof(uint32_t));
+    activeSize += RecordHeaderSize + length;
+
+    bool written = true;
+    if (buffer.size() >= FlushSize) {
+        written = flushBuffer();
+    }
+    if (unsyncedBytes + buffer.size() >= SyncBytes || std::chrono::steady_clock::now() - lastSync >= SyncInterval) {
+        written = syncNow() && written;
+    }
+    if (activeSize >= SegmentSize) {
+        written = roll() && written;
+    }
+    return written;
+}
+
+bool EventLog::sync() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fd >= 0 && syncNow();
+}
+
+std::shared_ptr<std::vector<std::shared_ptr<MappedFile>>> EventLog::mapSegments() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0) {
+        return nullptr;
+    }
+    auto segments = std::make_shared<std::vector<std::shared_ptr<MappedFile>>>();
+    // readers see everything appended so far, durability is still left to the batches
+    flushBuffer();
+    for (const auto &segment : sealed) {
+        segments->push_back(segment.second);
+    }
+    segments->push_back(std::make_shared<MappedFile>(segmentPath(activeSegment)));
+    return segments;
+}
+
+bool EventLog::snapshotUser(const std::string &channel, const std::string &user, EventSnapshot &snapshot,
+                            const SummaryFilter &filter, const StoreWindow *window) {
+    auto segments = mapSegments();
+    if (!segments) {
+        return false;
+    }
+
+    // the scan runs on the read-only mappings without holding the log's lock
+    snapshot.rows.clear();
+    snapshot.counts = SummaryCounts();
+    // a user that was never interned is only added once a record of theirs matches, so a
+    // mistyped name leaves nothing behind
+    uint32_t userId = 0;
+    bool userKnown = StringInterner::instance().find(user, userId);
+    TextIds ids;
+    bool channelFound = scanUser(*segments, channel, user, filter, window, [&](const RecordView &record) {
+        if (!userKnown) {
+            userId = internString(user);
+            userKnown = true;
+        }
+        snapshot.rows.push_back(EventRow{record.dateTime, userId, ids.idOf(record.name), ids.idOf(record.city),
+                                         record.flags, record.description.data, record.description.size});
+        snapshot.counts.add(record.flags);
+    });
+    // log order is arrival order, so a stable sort ties the same way the store does
+    const std::vector<EventRow> &rows = snapshot.rows;
+    std::vector<uint32_t> order = summaryOrder(rows.size(), [&rows](size_t i) { return rows[i].dateTime; },
+                                               [&rows](size_t i) { return rows[i].name; });
+    std::vector<EventRow> sorted;
+    sorted.reserve(rows.size());
+    for (uint32_t row : order) {
+        sorted.push_back(rows[row]);
+    }
+    snapshot.rows.swap(sorted);
+    snapshot.payload = segments;
+    return channelFound;
+}
+
+bool EventLog::countsOf(const std::string &channel, const std::string &user, SummaryCounts &counts,
+                        const StoreWindow *window) {
+    auto segments = mapSegments();
+    if (!segments) {
+        return false;
+    }
+    counts = SummaryCounts();
+    return scanUser(*segments, channel, user, SummaryFilter(), window,
+                    [&counts](const RecordView &record) { counts.add(record.flags); });
+}
+
+bool EventLog::newestDateTime(const std::string &channel, int &dateTime) {
+    auto segments = mapSegments();
+    if (!segments) {
+        return false;
+    }
+    bool first = true;
+    return scanChannel(*segments, channel, [&](const RecordView &record) {
+        if (first || record.dateTime > dateTime) {
+            dateTime = record.dateTime;
+            first = false;
+        }
+    });
+}
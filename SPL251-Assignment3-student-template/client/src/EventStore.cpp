@@ -0,0 +1,721 @@
+#include "../include/EventStore.h"
+#include "../include/RadixSort.h"
+#include <cstring>
+
+using namespace std;
+
+EventArena::EventArena() : blocks(std::make_shared<BlockList>()), current(nullptr), remaining(0), reserved(0) {}
+
+const char *EventArena::store(const std::string &value) {
+    return store(value.data(), value.size());
+}
+
+const char *EventArena::store(const char *data, size_t size) {
+    if (size == 0) {
+        return "";
+    }
+    if (size > remaining) {
+        // oversized values get a block of their own, the current block stays usable
+        size_t blockSize = size > BlockSize / 4 ? size : BlockSize;
+        blocks->emplace_back(new char[blockSize]);
+        reserved += blockSize;
+        if (blockSize != BlockSize) {
+            memcpy(blocks->back().get(), data, size);
+            return blocks->back().get();
+        }
+        current = blocks->back().get();
+        remaining = blockSize;
+    }
+    char *stored = current;
+    memcpy(stored, data, size);
+    current += size;
+    remaining -= size;
+    return stored;
+}
+
+std::shared_ptr<const void> EventArena::pin() const {
+    return blocks;
+}
+
+void EventArena::release() {
+    blocks = std::make_shared<BlockList>();
+    current = nullptr;
+    remaining = 0;
+    reserved = 0;
+}
+
+size_t EventArena::bytesReserved() const {
+    return reserved;
+}
+
+std::string EventRow::descriptionText() const {
+    return std::string(description, descriptionLength);
+}
+
+ChannelEvents::ChannelEvents()
+    : dateTimes(), users(), cities(), names(), flags(), descriptionData(), descriptionLengths(), arena(), ordered(), rowsByUser(),
+      countsByUser(), text(), trend(), trendByCity(), evicted(0), anyEvicted(false),
+      evictedDateTime(0), evictedName(StringInterner::EmptyId), liveDescriptionBytes(0) {}
+
+void ChannelEvents::add(const Event &event) {
+    // the description goes from the event straight into the arena, a received event never decodes it
+    add(EventRow{event.get_date_time(), event.getEventOwnerUserId(), internString(event.get_name()), event.get_city_id(),
+                 event.get_flags(), event.get_description_data(), static_cast<uint32_t>(event.get_description_size())});
+}
+
+void ChannelEvents::add(const EventRow &row) {
+    uint32_t id = static_cast<uint32_t>(dateTimes.size());
+    dateTimes.push_back(row.dateTime);
+    users.push_back(row.user);
+    cities.push_back(row.city);
+    names.push_back(row.name);
+    flags.push_back(row.flags);
+    descriptionData.push_back(arena.store(row.description, row.descriptionLength));
+    descriptionLengths.push_back(row.descriptionLength);
+    liveDescriptionBytes += row.descriptionLength;
+
+    auto less = [this](uint32_t a, uint32_t b) { return rowLess(a, b); };
+    ordered.insert(id, less);
+    rowsByUser[row.user].insert(id, less);
+    countsByUser[row.user].add(row.flags);
+    indexText(id);
+    trend.add(row.dateTime, row.flags);
+    trendByCity[row.city].add(row.dateTime, row.flags);
+}
+
+void ChannelEvents::indexText(uint32_t row) {
+    const std::string &name = internedString(names[row]);
+    text.add(row, name.data(), name.size());
+    text.add(row, descriptionData[row], descriptionLengths[row]);
+}
+
+// summary order: by date_time, then by event name
+bool ChannelEvents::rowLess(uint32_t a, uint32_t b) const {
+    if (dateTimes[a] != dateTimes[b]) {
+        return dateTimes[a] < dateTimes[b];
+    }
+    return names[a] != names[b] && internedString(names[a]) < internedString(names[b]);
+}
+
+size_t ChannelEvents::size() const {
+    return ordered.size();
+}
+
+bool ChannelEvents::empty() const {
+    return ordered.size() == 0;
+}
+
+size_t ChannelEvents::bytesUsed() const {
+    return ordered.size() * RowBytes + liveDescriptionBytes;
+}
+
+int ChannelEvents::oldestDateTime() const {
+    return dateTimes[ordered.front()];
+}
+
+int ChannelEvents::newestDateTime() const {
+    return dateTimes[ordered.back()];
+}
+
+// the oldest row of the channel is also the oldest of its user, both orders agree on ties
+void ChannelEvents::evictOldest() {
+    uint32_t row = ordered.front();
+    ordered.popFront();
+    auto userRows = rowsByUser.find(users[row]);
+    userRows->second.popFront();
+    auto userCounts = countsByUser.find(users[row]);
+    userCounts->second.remove(flags[row]);
+    if (userRows->second.size() == 0) {
+        rowsByUser.erase(userRows);
+        countsByUser.erase(userCounts);
+    }
+    liveDescriptionBytes -= descriptionLengths[row];
+    flags[row] |= EvictedFlag;
+    // a late row can be evicted after newer ones
+    if (!anyEvicted || StoreWindow::keyLess(evictedDateTime, evictedName, dateTimes[row], names[row])) {
+        anyEvicted = true;
+        evictedDateTime = dateTimes[row];
+        evictedName = names[row];
+    }
+    evicted++;
+    if (evicted >= CompactThreshold && evicted > ordered.size()) {
+        compact();
+    }
+}
+
+StoreWindow ChannelEvents::window() const {
+    StoreWindow window;
+    if (empty()) {
+        return window;
+    }
+    uint32_t oldest = ordered.front();
+    window.empty = false;
+    window.oldestDateTime = dateTimes[oldest];
+    window.oldestName = names[oldest];
+    window.evicted = anyEvicted;
+    window.evictedDateTime = evictedDateTime;
+    window.evictedName = evictedName;
+    return window;
+}
+
+// Rewrites the live rows in order into fresh columns and a fresh arena. Snapshots still
+// pin the old arena blocks, so they are freed once the last one is gone.
+void ChannelEvents::compact() {
+    std::vector<uint32_t> newRow(dateTimes.size());
+    std::vector<int> keptDateTimes;
+    std::vector<uint32_t> keptUsers, keptCities, keptNames, keptLengths;
+    std::vector<uint8_t> keptFlags;
+    std::vector<const char *> keptDescriptions;
+    EventArena keptArena;
+    size_t live = ordered.size();
+    keptDateTimes.reserve(live);
+    keptUsers.reserve(live);
+    keptCities.reserve(live);
+    keptNames.reserve(live);
+    keptLengths.reserve(live);
+    keptFlags.reserve(live);
+    keptDescriptions.reserve(live);
+    ordered.forEach([&](uint32_t row) {
+        newRow[row] = static_cast<uint32_t>(keptDateTimes.size());
+        keptDateTimes.push_back(dateTimes[row]);
+        keptUsers.push_back(users[row]);
+        keptCities.push_back(cities[row]);
+        keptNames.push_back(names[row]);
+        keptFlags.push_back(flags[row]);
+        keptDescriptions.push_back(keptArena.store(descriptionData[row], descriptionLengths[row]));
+        keptLengths.push_back(descriptionLengths[row]);
+    });
+
+    dateTimes.swap(keptDateTimes);
+    users.swap(keptUsers);
+    cities.swap(keptCities);
+    names.swap(keptNames);
+    flags.swap(keptFlags);
+    descriptionData.swap(keptDescriptions);
+    descriptionLengths.swap(keptLengths);
+    arena = std::move(keptArena);
+    evicted = 0;
+
+    // renumbering keeps the order, so both orders are rebuilt on the append fast path
+    auto less = [this](uint32_t a, uint32_t b) { return rowLess(a, b); };
+    OrderedRows keptOrder;
+    for (uint32_t row = 0; row < live; row++) {
+        keptOrder.insert(row, less);
+    }
+    ordered = std::move(keptOrder);
+    for (auto &user : rowsByUser) {
+        OrderedRows keptUserRows;
+        user.second.forEach([&](uint32_t row) { keptUserRows.insert(newRow[row], less); });
+        user.second = std::move(keptUserRows);
+    }
+    text.clear();
+    for (uint32_t row = 0; row < live; row++) {
+        indexText(row);
+    }
+}
+
+int ChannelEvents::dateTime(size_t row) const {
+    return dateTimes[row];
+}
+
+uint32_t ChannelEvents::user(size_t row) const {
+    return users[row];
+}
+
+uint32_t ChannelEvents::city(size_t row) const {
+    return cities[row];
+}
+
+uint32_t ChannelEvents::name(size_t row) const {
+    return names[row];
+}
+
+uint8_t ChannelEvents::flagsOf(size_t row) const {
+    return flags[row];
+}
+
+std::string ChannelEvents::description(size_t row) const {
+    return std::string(descriptionData[row], descriptionLengths[row]);
+}
+
+EventRow ChannelEvents::eventRow(uint32_t row) const {
+    return EventRow{dateTimes[row], users[row], names[row], cities[row], flags[row], descriptionData[row],
+                    descriptionLengths[row]};
+}
+
+std::shared_ptr<const void> ChannelEvents::pinPayload() const {
+    return arena.pin();
+}
+
+const std::vector<int> &ChannelEvents::dateTimeColumn() const {
+    return dateTimes;
+}
+
+const std::vector<uint32_t> &ChannelEvents::userColumn() const {
+    return users;
+}
+
+const std::vector<uint8_t> &ChannelEvents::flagColumn() const {
+    return flags;
+}
+
+const OrderedRows *ChannelEvents::rowsOf(uint32_t user) const {
+    auto it = rowsByUser.find(user);
+    return it == rowsByUser.end() ? nullptr : &it->second;
+}
+
+SummaryCounts ChannelEvents::countsOf(uint32_t user) const {
+    auto it = countsByUser.find(user);
+    return it == countsByUser.end() ? SummaryCounts() : it->second;
+}
+
+const OrderedRows &ChannelEvents::orderedRows() const {
+    return ordered;
+}
+
+std::vector<uint32_t> ChannelEvents::search(const TextQuery &query) const {
+    std::vector<uint32_t> rows = text.match(query);
+    rows.erase(std::remove_if(rows.begin(), rows.end(), [this](uint32_t row) { return (flags[row] & EvictedFlag) != 0; }),
+               rows.end());
+    if (rows.size() < ordered.size() / 16) {
+        std::vector<uint32_t> order = summaryOrder(rows.size(), [&](size_t i) { return dateTimes[rows[i]]; },
+                                                   [&](size_t i) { return names[rows[i]]; });
+        for (uint32_t &row : order) {
+            row = rows[row];
+        }
+        return order;
+    }
+    // a large share of the channel matched, one walk of the order beats sorting by name
+    std::vector<bool> matched(dateTimes.size());
+    for (uint32_t row : rows) {
+        matched[row] = true;
+    }
+    rows.clear();
+    ordered.forEach([&](uint32_t row) {
+        if (matched[row]) {
+            rows.push_back(row);
+        }
+    });
+    return rows;
+}
+
+const TextIndex &ChannelEvents::textIndex() const {
+    return text;
+}
+
+const TimeBuckets &ChannelEvents::trendBuckets() const {
+    return trend;
+}
+
+const TimeBuckets *ChannelEvents::cityTrendBuckets(uint32_t city) const {
+    auto it = trendByCity.find(city);
+    return it == trendByCity.end() ? nullptr : &it->second;
+}
+
+EventStore::Staged::Staged() : shard(std::make_shared<Shard>()) {}
+
+void EventStore::Staged::add(const Event &event) {
+    // not shared with anyone yet, so no lock
+    shard->events.add(event);
+}
+
+size_t EventStore::Staged::size() const {
+    return shard->events.size();
+}
+
+EventStore::EventStore()
+    : channelsMutex(), channels(), retention(), totalEvents(0), totalBytes(0), evictedByCount(0), evictedByAge(0),
+      evictedByBudget(0) {}
+
+std::shared_ptr<EventStore::Shard> EventStore::findShard(const std::string &channel) const {
+    uint32_t channelId;
+    if (!StringInterner::instance().find(channel, channelId)) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(channelsMutex);
+    auto it = channels.find(channelId);
+    return it == channels.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<EventStore::Shard> EventStore::shardFor(const std::string &channel, RetentionPolicy &policy) {
+    uint32_t channelId = internString(channel);
+    std::lock_guard<std::mutex> lock(channelsMutex);
+    policy = retention;
+    std::shared_ptr<Shard> &shard = channels[channelId];
+    if (!shard) {
+        shard = std::make_shared<Shard>();
+    }
+    return shard;
+}
+
+std::vector<std::shared_ptr<EventStore::Shard>> EventStore::allShards() const {
+    std::vector<std::shared_ptr<Shard>> shards;
+    std::lock_guard<std::mutex> lock(channelsMutex);
+    shards.reserve(channels.size());
+    for (const auto &channel : channels) {
+        shards.push_back(channel.second);
+    }
+    return shards;
+}
+
+void EventStore::trim(Shard &shard, const RetentionPolicy &policy, size_t eventsBefore, size_t bytesBefore) {
+    ChannelEvents &events = shard.events;
+    if (policy.maxEventsPerChannel != 0) {
+        while (events.size() > policy.maxEventsPerChannel) {
+            events.evictOldest();
+            evictedByCount++;
+        }
+    }
+    if (policy.maxAge != 0 && !events.empty()) {
+        long long cutoff = static_cast<long long>(events.newestDateTime()) - policy.maxAge;
+        while (!events.empty() && events.oldestDateTime() < cutoff) {
+            events.evictOldest();
+            evictedByAge++;
+        }
+    }
+    if (!shard.dropped) {
+        totalEvents += events.size();
+        totalEvents -= eventsBefore;
+        totalBytes += events.bytesUsed();
+        totalBytes -= bytesBefore;
+    }
+}
+
+void EventStore::enforceBudget(size_t maxBytes) {
+    // evicting a batch at a time keeps the scan for the oldest channel off the per event path
+    const size_t EvictBatch = 64;
+    while (totalBytes.load() > maxBytes) {
+        std::shared_ptr<Shard> oldest;
+        int oldestDateTime = 0;
+        for (const std::shared_ptr<Shard> &shard : allShards()) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            if (!shard->events.empty() && (!oldest || shard->events.oldestDateTime() < oldestDateTime)) {
+                oldest = shard;
+                oldestDateTime = shard->events.oldestDateTime();
+            }
+        }
+        if (!oldest) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(oldest->mutex);
+        ChannelEvents &events = oldest->events;
+        for (size_t i = 0; i < EvictBatch && !events.empty() && totalBytes.load() > maxBytes; i++) {
+            size_t bytesBefore = events.bytesUsed();
+            events.evictOldest();
+            evictedByBudget++;
+            if (!oldest->dropped) {
+                totalEvents--;
+                totalBytes -= bytesBefore - events.bytesUsed();
+            }
+        }
+    }
+}
+
+template <typename Fill>
+void EventStore::addTo(const std::string &channel, const Fill &fill) {
+    RetentionPolicy policy;
+    std::shared_ptr<Shard> shard = shardFor(channel, policy);
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        size_t eventsBefore = shard->events.size();
+        size_t bytesBefore = shard->events.bytesUsed();
+        fill(shard->events);
+        trim(*shard, policy, eventsBefore, bytesBefore);
+    }
+    if (policy.maxBytes != 0 && totalBytes.load() > policy.maxBytes) {
+        enforceBudget(policy.maxBytes);
+    }
+}
+
+void EventStore::add(const std::string &channel, const Event &event) {
+    addTo(channel, [&event](ChannelEvents &events) { events.add(event); });
+}
+
+void EventStore::add(const std::string &channel, const std::vector<Event> &events) {
+    addTo(channel, [&events](ChannelEvents &channelEvents) {
+        for (const Event &event : events) {
+            channelEvents.add(event);
+        }
+    });
+}
+
+void EventStore::add(const std::string &channel, const std::vector<EventRow> &rows) {
+    addTo(channel, [&rows](ChannelEvents &events) {
+        for (const EventRow &row : rows) {
+            events.add(row);
+        }
+    });
+}
+
+void EventStore::add(const std::string &channel, const Staged &staged) {
+    const ChannelEvents &rows = staged.shard->events;
+    addTo(channel, [&rows](ChannelEvents &events) {
+        rows.orderedRows().forEach([&rows, &events](uint32_t row) { events.add(rows.eventRow(row)); });
+    });
+}
+
+void EventStore::replace(const std::string &channel, const std::vector<Event> &events) {
+    Staged staged;
+    for (const Event &event : events) {
+        staged.add(event);
+    }
+    replace(channel, staged);
+}
+
+void EventStore::replace(const std::string &channel, Staged &staged) {
+    uint32_t channelId = internString(channel);
+    RetentionPolicy policy = retentionPolicy();
+    std::shared_ptr<Shard> fresh = std::move(staged.shard);
+    staged.shard = std::make_shared<Shard>();
+    {
+        std::lock_guard<std::mutex> lock(fresh->mutex);
+        trim(*fresh, policy, 0, 0);
+    }
+    std::shared_ptr<Shard> replaced;
+    {
+        std::lock_guard<std::mutex> lock(channelsMutex);
+        std::shared_ptr<Shard> &shard = channels[channelId];
+        replaced = shard;
+        shard = fresh;
+    }
+    if (replaced) {
+        std::lock_guard<std::mutex> lock(replaced->mutex);
+        replaced->dropped = true;
+        totalEvents -= replaced->events.size();
+        totalBytes -= replaced->events.bytesUsed();
+    }
+    if (policy.maxBytes != 0 && totalBytes.load() > policy.maxBytes) {
+        enforceBudget(policy.maxBytes);
+    }
+}
+
+bool EventStore::hasChannel(const std::string &channel) const {
+    return findShard(channel) != nullptr;
+}
+
+bool EventStore::newestDateTime(const std::string &channel, int &dateTime) const {
+    std::shared_ptr<Shard> shard = findShard(channel);
+    if (!shard) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (shard->events.empty()) {
+        return false;
+    }
+    dateTime = shard->events.newestDateTime();
+    return true;
+}
+
+std::vector<std::string> EventStore::channelNames() const {
+    std::vector<std::string> names;
+    std::lock_guard<std::mutex> lock(channelsMutex);
+    names.reserve(channels.size());
+    for (const auto &channel : channels) {
+        names.push_back(internedString(channel.first));
+    }
+    return names;
+}
+
+bool EventStore::snapshotChannel(const std::string &channel, EventSnapshot &snapshot) const {
+    std::shared_ptr<Shard> shard = findShard(channel);
+    if (!shard) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    const ChannelEvents &events = shard->events;
+    snapshot.rows.clear();
+    snapshot.rows.reserve(events.size());
+    events.orderedRows().forEach([&](uint32_t row) { snapshot.rows.push_back(events.eventRow(row)); });
+    snapshot.payload = events.pinPayload();
+    return true;
+}
+
+bool EventStore::snapshotUser(const std::string &channel, const std::string &user, EventSnapshot &snapshot,
+                              const SummaryFilter &filter, StoreWindow *window) const {
+    std::shared_ptr<Shard> shard = findShard(channel);
+    if (!shard) {
+        return false;
+    }
+    snapshot.rows.clear();
+    snapshot.counts = SummaryCounts();
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    const ChannelEvents &events = shard->events;
+    if (window != nullptr) {
+        *window = events.window();
+    }
+    uint32_t userId, cityId = 0;
+    if (!StringInterner::instance().find(user, userId) ||
+        (filter.byCity && !StringInterner::instance().find(filter.city, cityId))) {
+        return true;
+    }
+    const OrderedRows *rows = events.rowsOf(userId);
+    if (rows != nullptr && filter.empty()) {
+        // every row goes out, the running counters already hold their counts
+        snapshot.rows.reserve(rows->size());
+        rows->forEach([&](uint32_t row) { snapshot.rows.push_back(events.eventRow(row)); });
+        snapshot.counts = events.countsOf(userId);
+    } else if (rows != nullptr) {
+        const std::vector<int> &dateTimes = events.dateTimeColumn();
+        rows->forEachFrom([&](uint32_t row) { return dateTimes[row] < filter.from; },
+                          [&](uint32_t row) {
+                              if (dateTimes[row] > filter.to) {
+                                  return false;
+                              }
+                              if (filter.matches(dateTimes[row], events.flagsOf(row)) &&
+                                  (!filter.byCity || events.city(row) == cityId)) {
+                                  snapshot.rows.push_back(events.eventRow(row));
+                                  snapshot.counts.add(events.flagsOf(row));
+                              }
+                              return true;
+                          });
+    }
+    if (window != nullptr && window->evicted) {
+        // the rows ahead of the window came back late, the event log answers for them
+        std::vector<EventRow> &taken = snapshot.rows;
+        auto held = std::find_if(taken.begin(), taken.end(),
+                                 [window](const EventRow &row) { return window->holds(row.dateTime, row.name); });
+        for (auto row = taken.begin(); row != held; ++row) {
+            snapshot.counts.remove(row->flags);
+        }
+        taken.erase(taken.begin(), held);
+    }
+    snapshot.payload = events.pinPayload();
+    return true;
+}
+
+bool EventStore::search(const std::string &channel, const TextQuery &query, EventSnapshot &snapshot) const {
+    std::shared_ptr<Shard> shard = findShard(channel);
+    if (!shard) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    const ChannelEvents &events = shard->events;
+    snapshot.rows.clear();
+    snapshot.counts = SummaryCounts();
+    for (uint32_t row : events.search(query)) {
+        snapshot.rows.push_back(events.eventRow(row));
+        snapshot.counts.add(events.flagsOf(row));
+    }
+    snapshot.payload = events.pinPayload();
+    return true;
+}
+
+bool EventStore::channelTrend(const std::string &channel, TimeBuckets &buckets) const {
+    std::shared_ptr<Shard> shard = findShard(channel);
+    if (!shard) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    buckets = shard->events.trendBuckets();
+    return true;
+}
+
+bool EventStore::cityTrend(const std::string &city, TimeBuckets &buckets) const {
+    buckets = TimeBuckets();
+    uint32_t cityId;
+    if (!StringInterner::instance().find(city, cityId)) {
+        return false;
+    }
+    for (const std::shared_ptr<Shard> &shard : allShards()) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        const TimeBuckets *cityBuckets = shard->events.cityTrendBuckets(cityId);
+        if (cityBuckets != nullptr) {
+            buckets.merge(*cityBuckets);
+        }
+    }
+    return !buckets.empty();
+}
+
+bool EventStore::countsOf(const std::string &channel, const std::string &user, SummaryCounts &counts,
+                          StoreWindow *window) const {
+    std::shared_ptr<Shard> shard = findShard(channel);
+    if (!shard) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (window != nullptr) {
+        *window = shard->events.window();
+    }
+    uint32_t userId;
+    const ChannelEvents &events = shard->events;
+    counts = StringInterner::instance().find(user, userId) ? events.countsOf(userId) : SummaryCounts();
+    const OrderedRows *rows = counts.total > 0 ? events.rowsOf(userId) : nullptr;
+    if (window != nullptr && window->evicted && rows != nullptr) {
+        rows->forEachFrom([](uint32_t) { return false; }, [&](uint32_t row) {
+            if (window->holds(events.dateTime(row), events.name(row))) {
+                return false;
+            }
+            counts.remove(events.flagsOf(row));
+            return true;
+        });
+    }
+    return true;
+}
+
+void EventStore::dropChannel(const std::string &channel) {
+    uint32_t channelId;
+    if (!StringInterner::instance().find(channel, channelId)) {
+        return;
+    }
+    std::shared_ptr<Shard> dropped;
+    {
+        std::lock_guard<std::mutex> lock(channelsMutex);
+        auto it = channels.find(channelId);
+        if (it == channels.end()) {
+            return;
+        }
+        dropped = it->second;
+        channels.erase(it);
+    }
+    {
+        std::lock_guard<std::mutex> lock(dropped->mutex);
+        dropped->dropped = true;
+        totalEvents -= dropped->events.size();
+        totalBytes -= dropped->events.bytesUsed();
+    }
+    // the arena goes back here, outside the map lock, unless a snapshot still pins it
+}
+
+void EventStore::clear() {
+    std::map<uint32_t, std::shared_ptr<Shard>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(channelsMutex);
+        dropped.swap(channels);
+    }
+    for (auto &channel : dropped) {
+        std::lock_guard<std::mutex> lock(channel.second->mutex);
+        channel.second->dropped = true;
+        totalEvents -= channel.second->events.size();
+        totalBytes -= channel.second->events.bytesUsed();
+    }
+    // shards are freed here, outside the map lock
+}
+
+void EventStore::setRetention(const RetentionPolicy &policy) {
+    {
+        std::lock_guard<std::mutex> lock(channelsMutex);
+        retention = policy;
+    }
+    for (const std::shared_ptr<Shard> &shard : allShards()) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        trim(*shard, policy, shard->events.size(), shard->events.bytesUsed());
+    }
+    if (policy.maxBytes != 0) {
+        enforceBudget(policy.maxBytes);
+    }
+}
+
+RetentionPolicy EventStore::retentionPolicy() const {
+    std::lock_guard<std::mutex> lock(channelsMutex);
+    return retention;
+}
+
+RetentionStats EventStore::retentionStats() const {
+    size_t channelCount;
+    {
+        std::lock_guard<std::mutex> lock(channelsMutex);
+        channelCount = channels.size();
+    }
+    return RetentionStats{channelCount, totalEvents.load(), totalBytes.load(), evictedByCount.load(), evictedByAge.load(),
+                          evictedByBudget.load()};
+}
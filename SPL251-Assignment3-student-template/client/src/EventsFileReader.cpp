@@ -0,0 +1,810 @@
+#include "../include/EventsFileReader.h"
+#include "../include/json.hpp"
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+using json = nlohmann::json;
+
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *mapping = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::madvise(mapping, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            data_ = static_cast<const char *>(mapping);
+            size_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+bool MappedFile::isOpen() const {
+    return data_ != nullptr;
+}
+
+const char *MappedFile::data() const {
+    return data_;
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
+
+namespace {
+
+// A JSON string or literal inside the mapping. Strings with escape sequences are only
+// decoded when converted to std::string.
+struct TextSlice {
+    const char *data;
+    size_t size;
+    bool escaped;
+
+    bool equals(const char *text) const {
+        size_t length = strlen(text);
+        return !escaped && size == length && memcmp(data, text, length) == 0;
+    }
+
+    std::string str() const;
+};
+
+unsigned hexValue(const char *p) {
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= static_cast<unsigned>(c - '0');
+        else if (c >= 'a' && c <= 'f') value |= static_cast<unsigned>(c - 'a' + 10);
+        else value |= static_cast<unsigned>(c - 'A' + 10);
+    }
+    return value;
+}
+
+void appendUtf8(std::string &out, unsigned codepoint) {
+    if (codepoint < 0x80) {
+        out += static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codepoint >> 6));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codepoint >> 12));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codepoint >> 18));
+        out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+// escapes were validated by the tokenizer before a slice is ever decoded
+std::string TextSlice::str() const {
+    if (!escaped) {
+        return std::string(data, size);
+    }
+    std::string out;
+    out.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != '\\') {
+            out += data[i];
+            continue;
+        }
+        char c = data[++i];
+        switch (c) {
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            unsigned codepoint = hexValue(data + i + 1);
+            i += 4;
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                unsigned low = hexValue(data + i + 3);
+                i += 6;
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+            }
+            appendUtf8(out, codepoint);
+            break;
+        }
+        default: out += c; break;
+        }
+    }
+    return out;
+}
+
+// Recursive descent over the known schema. Any deviation (unknown key, float, nested
+// value, invalid UTF-8, ...) makes it give up so the generic parser can decide.
+class EventsFileTokenizer {
+private:
+    const char *begin;
+    const char *pos;
+    const char *end;
+    const std::string &eventOwnerUser;
+    const EventsFile::Consumer *consumer;
+    bool hasChannel;
+    std::string channel_name;
+    // events read before channel_name, with their positions
+    std::vector<std::pair<Event, size_t>> pending;
+
+    void skipWhitespace() {
+        while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+            pos++;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (pos < end && *pos == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c) {
+        skipWhitespace();
+        return pos < end && *pos == c;
+    }
+
+    bool isHex(char c) const {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    // length of the UTF-8 sequence starting at p, 0 if it is not valid
+    size_t utf8Length(const char *p) const {
+        unsigned char c = static_cast<unsigned char>(*p);
+        size_t length;
+        unsigned min;
+        unsigned codepoint;
+        if (c >= 0xC2 && c <= 0xDF) { length = 2; min = 0x80; codepoint = c & 0x1F; }
+        else if (c >= 0xE0 && c <= 0xEF) { length = 3; min = 0x800; codepoint = c & 0x0F; }
+        else if (c >= 0xF0 && c <= 0xF4) { length = 4; min = 0x10000; codepoint = c & 0x07; }
+        else return 0;
+        if (static_cast<size_t>(end - p) < length) {
+            return 0;
+        }
+        for (size_t i = 1; i < length; i++) {
+            unsigned char next = static_cast<unsigned char>(p[i]);
+            if ((next & 0xC0) != 0x80) {
+                return 0;
+            }
+            codepoint = (codepoint << 6) | (next & 0x3F);
+        }
+        if (codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+            return 0;
+        }
+        return length;
+    }
+
+    bool readString(TextSlice &out) {
+        if (!consume('"')) {
+            return false;
+        }
+        out = TextSlice{pos, 0, false};
+        while (pos < end) {
+            unsigned char c = static_cast<unsigned char>(*pos);
+            if (c == '"') {
+                out.size = static_cast<size_t>(pos - out.data);
+                pos++;
+                return true;
+            }
+            if (c < 0x20) {
+                return false;
+            }
+            if (c == '\\') {
+                out.escaped = true;
+                if (end - pos < 2) {
+                    return false;
+                }
+                char e = pos[1];
+                if (e == 'u') {
+                    if (end - pos < 6 || !isHex(pos[2]) || !isHex(pos[3]) || !isHex(pos[4]) || !isHex(pos[5])) {
+                        return false;
+                    }
+                    unsigned codepoint = hexValue(pos + 2);
+                    pos += 6;
+                    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                        return false;
+                    }
+                    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                        if (end - pos < 6 || pos[0] != '\\' || pos[1] != 'u' || !isHex(pos[2]) || !isHex(pos[3]) ||
+                            !isHex(pos[4]) || !isHex(pos[5])) {
+                            return false;
+                        }
+                        unsigned low = hexValue(pos + 2);
+                        if (low < 0xDC00 || low > 0xDFFF) {
+                            return false;
+                        }
+                        pos += 6;
+                    }
+                    continue;
+                }
+                if (e != '"' && e != '\\' && e != '/' && e != 'b' && e != 'f' && e != 'n' && e != 'r' && e != 't') {
+                    return false;
+                }
+                pos += 2;
+                continue;
+            }
+            if (c >= 0x80) {
+                size_t length = utf8Length(pos);
+                if (length == 0) {
+                    return false;
+                }
+                pos += length;
+                continue;
+            }
+            pos++;
+        }
+        return false;
+    }
+
+    // plain integers only, floats and exponents are left to the generic parser
+    bool readInteger(long long &value, TextSlice &literal) {
+        skipWhitespace();
+        literal = TextSlice{pos, 0, false};
+        bool negative = false;
+        if (pos < end && *pos == '-') {
+            negative = true;
+            pos++;
+        }
+        const char *digits = pos;
+        while (pos < end && *pos >= '0' && *pos <= '9') {
+            pos++;
+        }
+        size_t digitCount = static_cast<size_t>(pos - digits);
+        if (digitCount == 0 || digitCount > 18 || (digits[0] == '0' && (digitCount > 1 || negative))) {
+            return false;
+        }
+        if (pos < end && (*pos == '.' || *pos == 'e' || *pos == 'E')) {
+            return false;
+        }
+        value = 0;
+        for (const char *p = digits; p < pos; p++) {
+            value = value * 10 + (*p - '0');
+        }
+        if (negative) {
+            value = -value;
+        }
+        literal.size = static_cast<size_t>(pos - literal.data);
+        return true;
+    }
+
+    bool readKeyword(const char *keyword, TextSlice &literal) {
+        size_t length = strlen(keyword);
+        if (static_cast<size_t>(end - pos) < length || memcmp(pos, keyword, length) != 0) {
+            return false;
+        }
+        literal = TextSlice{pos, length, false};
+        pos += length;
+        return true;
+    }
+
+    // general information values are stored the way nlohmann's dump() prints scalars
+    bool readScalar(TextSlice &value, bool &isString) {
+        skipWhitespace();
+        if (pos >= end) {
+            return false;
+        }
+        isString = false;
+        switch (*pos) {
+        case '"':
+            isString = true;
+            return readString(value);
+        case 't':
+            return readKeyword("true", value);
+        case 'f':
+            return readKeyword("false", value);
+        case 'n':
+            return readKeyword("null", value);
+        default: {
+            long long ignored;
+            return readInteger(ignored, value);
+        }
+        }
+    }
+
+    bool readGeneralInformation(std::map<std::string, std::string> &general_information) {
+        if (!consume('{')) {
+            return false;
+        }
+        if (consume('}')) {
+            return true;
+        }
+        do {
+            TextSlice key;
+            TextSlice value;
+            bool isString;
+            if (!readString(key) || !consume(':') || !readScalar(value, isString)) {
+                return false;
+            }
+            general_information[key.str()] = value.str();
+        } while (consume(','));
+        return consume('}');
+    }
+
+    bool readEvent() {
+        skipWhitespace();
+        size_t position = static_cast<size_t>(pos - begin);
+        if (!consume('{')) {
+            return false;
+        }
+        TextSlice name{nullptr, 0, false};
+        TextSlice city{nullptr, 0, false};
+        TextSlice description{nullptr, 0, false};
+        long long date_time = 0;
+        bool hasName = false, hasCity = false, hasDescription = false, hasDateTime = false;
+        std::map<std::string, std::string> general_information;
+
+        if (!peek('}')) {
+            do {
+                TextSlice key;
+                if (!readString(key) || !consume(':')) {
+                    return false;
+                }
+                if (key.equals("event_name")) {
+                    hasName = readString(name);
+                    if (!hasName) return false;
+                } else if (key.equals("city")) {
+                    hasCity = readString(city);
+                    if (!hasCity) return false;
+                } else if (key.equals("description")) {
+                    hasDescription = readString(description);
+                    if (!hasDescription) return false;
+                } else if (key.equals("date_time")) {
+                    TextSlice literal;
+                    hasDateTime = readInteger(date_time, literal) && date_time >= INT_MIN && date_time <= INT_MAX;
+                    if (!hasDateTime) return false;
+                } else if (key.equals("general_information")) {
+                    general_information.clear();
+                    if (!readGeneralInformation(general_information)) return false;
+                } else {
+                    return false;
+                }
+            } while (consume(','));
+        }
+        if (!consume('}') || !hasName || !hasCity || !hasDescription || !hasDateTime) {
+            return false;
+        }
+
+        Event event(channel_name, city.str(), name.str(), static_cast<int>(date_time), description.str(),
+                    general_information);
+        event.setEventOwnerUser(eventOwnerUser);
+        if (hasChannel) {
+            (*consumer)(event, position);
+        } else {
+            pending.emplace_back(event, position);
+        }
+        return true;
+    }
+
+    bool readEvents() {
+        if (!consume('[')) {
+            return false;
+        }
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            if (!readEvent()) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+
+public:
+    EventsFileTokenizer(const char *begin, const char *end, const std::string &eventOwnerUser)
+        : begin(begin), pos(begin), end(end), eventOwnerUser(eventOwnerUser), consumer(nullptr),
+          hasChannel(false), channel_name(), pending() {}
+    EventsFileTokenizer(const EventsFileTokenizer &) = delete;
+    EventsFileTokenizer &operator=(const EventsFileTokenizer &) = delete;
+
+    // One pass that hands every event to eventConsumer as soon as it is read, or once
+    // channel_name is read if that follows the events. Returns false where the file deviates
+    // from the schema, a repeated top-level key included; the events handed out up to there
+    // are the ones the generic parser reads first.
+    bool run(const EventsFile::Consumer &eventConsumer) {
+        pos = begin;
+        consumer = &eventConsumer;
+        bool hasEvents = false;
+        if (!consume('{')) {
+            return false;
+        }
+        if (!peek('}')) {
+            do {
+                TextSlice key;
+                if (!readString(key) || !consume(':')) {
+                    return false;
+                }
+                if (key.equals("channel_name")) {
+                    TextSlice channel;
+                    if (hasChannel || !readString(channel)) return false;
+                    hasChannel = true;
+                    channel_name = channel.str();
+                    for (auto &event : pending) {
+                        event.first.setChannelName(channel_name);
+                        (*consumer)(event.first, event.second);
+                    }
+                    pending.clear();
+                } else if (key.equals("events")) {
+                    if (hasEvents || !readEvents()) return false;
+                    hasEvents = true;
+                } else {
+                    return false;
+                }
+            } while (consume(','));
+        }
+        if (!consume('}')) {
+            return false;
+        }
+        skipWhitespace();
+        return pos == end && hasChannel;
+    }
+
+    // reads the one event at position of a file whose channel is known
+    bool readEventAt(size_t position, const std::string &channelName, const EventsFile::Consumer &eventConsumer) {
+        pos = begin + position;
+        consumer = &eventConsumer;
+        hasChannel = true;
+        channel_name = channelName;
+        return readEvent();
+    }
+
+    const std::string &channelName() const {
+        return channel_name;
+    }
+};
+
+// Walks the bytes of a file for nlohmann's parser and records how far the parser got, so the
+// SAX handler knows where each event object starts
+class TrackingIterator {
+private:
+    const char *current;
+    const char **cursor;
+
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef char value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const char *pointer;
+    typedef const char &reference;
+
+    TrackingIterator(const char *current, const char **cursor) : current(current), cursor(cursor) {}
+
+    reference operator*() const {
+        return *current;
+    }
+
+    TrackingIterator &operator++() {
+        *cursor = ++current;
+        return *this;
+    }
+
+    bool operator==(const TrackingIterator &other) const {
+        return current == other.current;
+    }
+
+    bool operator!=(const TrackingIterator &other) const {
+        return current != other.current;
+    }
+};
+
+// SAX handler for the events file. Every element of "events" becomes an Event as soon as
+// its object closes, so the file is never held as a DOM.
+class EventsFileHandler : public nlohmann::json_sax<json> {
+private:
+    enum class Scope { Root, Events, Event, GeneralInformation, Other };
+
+    const std::string &eventOwnerUser;
+    const EventsFile::Consumer &consumer;
+    // first byte of the file and how far the parser got
+    const char *begin;
+    const char *const *cursor;
+    // reading a single event from its position on, see EventsFile::eventAt
+    bool singleEvent;
+    // events the tokenizer handed out before it gave up, not handed out again
+    size_t skip;
+    std::vector<Scope> scopes;
+    std::string currentKey;
+
+    bool hasChannel;
+    bool hasEvents;
+    std::string channel_name;
+    // events that closed before channel_name was seen, with their positions
+    std::vector<std::pair<Event, size_t>> pending;
+
+    // fields of the event currently being read
+    size_t position;
+    std::string name;
+    std::string city;
+    std::string description;
+    int date_time;
+    int seenFields;
+    std::map<std::string, std::string> general_information;
+
+    // general information values that are objects or arrays are rebuilt and stored as their dump
+    std::vector<json> nested;
+    std::vector<std::string> nestedKeys;
+
+    enum Field { NameField = 1, CityField = 2, DateTimeField = 4, DescriptionField = 8, AllFields = 15 };
+
+    Scope scope() const {
+        return scopes.empty() ? Scope::Other : scopes.back();
+    }
+
+    void addNested(json value, const std::string &valueKey) {
+        if (nested.back().is_object()) {
+            nested.back()[valueKey] = std::move(value);
+        } else {
+            nested.back().push_back(std::move(value));
+        }
+    }
+
+    void openNested(json container) {
+        nestedKeys.push_back(currentKey);
+        nested.push_back(std::move(container));
+    }
+
+    void closeNested() {
+        json done = std::move(nested.back());
+        nested.pop_back();
+        std::string doneKey = nestedKeys.back();
+        nestedKeys.pop_back();
+        if (nested.empty()) {
+            general_information[doneKey] = done.dump();
+        } else {
+            addNested(std::move(done), doneKey);
+        }
+    }
+
+    bool onValue(json value) {
+        if (!nested.empty()) {
+            addNested(std::move(value), currentKey);
+            return true;
+        }
+        switch (scope()) {
+        case Scope::Root:
+            if (currentKey == "channel_name") {
+                if (hasChannel) {
+                    throw std::runtime_error("events file has more than one channel_name");
+                }
+                channel_name = value.get<std::string>();
+                hasChannel = true;
+                for (auto &event : pending) {
+                    event.first.setChannelName(channel_name);
+                    handOut(event.first, event.second);
+                }
+                pending.clear();
+            }
+            break;
+        case Scope::Event:
+            if (currentKey == "event_name") {
+                name = value.get<std::string>();
+                seenFields |= NameField;
+            } else if (currentKey == "city") {
+                city = value.get<std::string>();
+                seenFields |= CityField;
+            } else if (currentKey == "date_time") {
+                date_time = value.get<int>();
+                seenFields |= DateTimeField;
+            } else if (currentKey == "description") {
+                description = value.get<std::string>();
+                seenFields |= DescriptionField;
+            }
+            break;
+        case Scope::GeneralInformation:
+            if (value.is_string())
+                general_information[currentKey] = value.get<std::string>();
+            else
+                general_information[currentKey] = value.dump();
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    void handOut(Event &event, size_t eventPosition) {
+        if (skip > 0) {
+            skip--;
+        } else {
+            consumer(event, eventPosition);
+        }
+    }
+
+    void emitEvent() {
+        if (seenFields != AllFields) {
+            throw std::runtime_error("event is missing one of event_name, city, date_time, description");
+        }
+        Event event(channel_name, city, name, date_time, description, general_information);
+        event.setEventOwnerUser(eventOwnerUser);
+        if (hasChannel) {
+            handOut(event, position);
+        } else {
+            pending.emplace_back(event, position);
+        }
+    }
+
+public:
+    EventsFileHandler(const std::string &eventOwnerUser, const EventsFile::Consumer &consumer, const char *begin,
+                      const char *const *cursor, size_t skip)
+        : eventOwnerUser(eventOwnerUser), consumer(consumer), begin(begin), cursor(cursor), singleEvent(false), skip(skip),
+          scopes(), currentKey(), hasChannel(false), hasEvents(false), channel_name(), pending(), position(0), name(),
+          city(), description(),
+          date_time(0), seenFields(0), general_information(), nested(), nestedKeys() {}
+    EventsFileHandler(const EventsFileHandler &) = delete;
+    EventsFileHandler &operator=(const EventsFileHandler &) = delete;
+
+    // the parse starts at the event's '{' and stops once the event is handed out
+    void readSingleEvent(const std::string &channelName) {
+        singleEvent = true;
+        hasChannel = true;
+        channel_name = channelName;
+        scopes = {Scope::Root, Scope::Events};
+    }
+
+    const std::string &channelName() const {
+        if (!hasChannel) {
+            throw std::runtime_error("events file has no channel_name");
+        }
+        return channel_name;
+    }
+
+    bool null() override { return onValue(json(nullptr)); }
+    bool boolean(bool val) override { return onValue(json(val)); }
+    bool number_integer(number_integer_t val) override { return onValue(json(val)); }
+    bool number_unsigned(number_unsigned_t val) override { return onValue(json(val)); }
+    bool number_float(number_float_t val, const string_t &) override { return onValue(json(val)); }
+    bool string(string_t &val) override { return onValue(json(val)); }
+    bool binary(binary_t &val) override { return onValue(json(val)); }
+
+    bool key(string_t &val) override {
+        currentKey = val;
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        if (!nested.empty() || scope() == Scope::GeneralInformation) {
+            openNested(json::object());
+        } else if (scopes.empty()) {
+            scopes.push_back(Scope::Root);
+        } else if (scope() == Scope::Events) {
+            // the parser has just consumed the event's '{'
+            position = static_cast<size_t>(*cursor - begin) - 1;
+            name.clear();
+            city.clear();
+            description.clear();
+            date_time = 0;
+            seenFields = 0;
+            general_information.clear();
+            scopes.push_back(Scope::Event);
+        } else if (scope() == Scope::Event && currentKey == "general_information") {
+            // a repeated general_information replaces the earlier one, as it would in a DOM
+            general_information.clear();
+            scopes.push_back(Scope::GeneralInformation);
+        } else {
+            scopes.push_back(Scope::Other);
+        }
+        return true;
+    }
+
+    bool end_object() override {
+        if (!nested.empty()) {
+            closeNested();
+            return true;
+        }
+        Scope closed = scope();
+        scopes.pop_back();
+        if (closed == Scope::Event) {
+            emitEvent();
+            return !singleEvent;
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        if (!nested.empty() || scope() == Scope::GeneralInformation) {
+            openNested(json::array());
+        } else if (scope() == Scope::Root && currentKey == "events") {
+            if (hasEvents) {
+                throw std::runtime_error("events file has more than one events array");
+            }
+            hasEvents = true;
+            scopes.push_back(Scope::Events);
+        } else {
+            scopes.push_back(Scope::Other);
+        }
+        return true;
+    }
+
+    bool end_array() override {
+        if (!nested.empty()) {
+            closeNested();
+        } else {
+            scopes.pop_back();
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &ex) override {
+        throw std::runtime_error(ex.what());
+    }
+};
+
+} // namespace
+
+EventsFile::EventsFile(const std::string &path, const std::string &eventOwnerUser)
+    : file(path), contents(), begin(nullptr), end(nullptr), eventOwnerUser(eventOwnerUser), channel_name()
+{
+    if (file.isOpen()) {
+        begin = file.data();
+        end = file.data() + file.size();
+        return;
+    }
+    // empty, missing or not mappable, the parser reports whatever is wrong with it
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    begin = contents.data();
+    end = contents.data() + contents.size();
+}
+
+const std::string &EventsFile::read(const Consumer &consumer) {
+    size_t handedOut = 0;
+    Consumer counting = [&consumer, &handedOut](Event &event, size_t position) {
+        handedOut++;
+        consumer(event, position);
+    };
+    EventsFileTokenizer tokenizer(begin, end, eventOwnerUser);
+    if (tokenizer.run(counting)) {
+        channel_name = tokenizer.channelName();
+        return channel_name;
+    }
+
+    // not the expected layout, the generic parser reads the file again and handles or rejects
+    // the rest; both read the same events up to where the tokenizer gave up
+    const char *cursor = begin;
+    EventsFileHandler handler(eventOwnerUser, consumer, begin, &cursor, handedOut);
+    json::sax_parse(TrackingIterator(begin, &cursor), TrackingIterator(end, &cursor), &handler);
+    channel_name = handler.channelName();
+    return channel_name;
+}
+
+Event EventsFile::eventAt(size_t position) const {
+    std::unique_ptr<Event> result;
+    Consumer keep = [&result](Event &event, size_t) { result.reset(new Event(event)); };
+    EventsFileTokenizer tokenizer(begin, end, eventOwnerUser);
+    if (!tokenizer.readEventAt(position, channel_name, keep)) {
+        // an event the tokenizer gives up on was read by the generic parser
+        const char *cursor = begin + position;
+        EventsFileHandler handler(eventOwnerUser, keep, begin, &cursor, 0);
+        handler.readSingleEvent(channel_name);
+        json::sax_parse(TrackingIterator(begin + position, &cursor), TrackingIterator(end, &cursor), &handler);
+    }
+    if (!result) {
+        throw std::runtime_error("no event at position " + std::to_string(position));
+    }
+    return *result;
+}
@@ -0,0 +1,132 @@
+#include "../include/RadixSort.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+namespace {
+
+const size_t SmallSortSize = 256;
+const size_t ParallelSortSize = 256 * 1024;
+const size_t MaxSortThreads = 8;
+const int DigitBits = 8;
+const size_t Buckets = 1 << DigitBits;
+
+struct KeyedIndex {
+    uint64_t key;
+    uint32_t index;
+};
+
+// Holds every thread that calls wait() until all of them have, then lets them go together;
+// reusable for the next round
+class Barrier {
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    size_t threads;
+    size_t waiting;
+    size_t generation;
+
+public:
+    explicit Barrier(size_t threads) : mutex(), released(), threads(threads), waiting(0), generation(0) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t arrival = generation;
+        if (++waiting == threads) {
+            waiting = 0;
+            generation++;
+            released.notify_all();
+            return;
+        }
+        released.wait(lock, [this, arrival] { return generation != arrival; });
+    }
+};
+
+} // namespace
+
+std::vector<uint32_t> radixOrder(const std::vector<uint64_t> &keys, size_t maxThreads) {
+    size_t count = keys.size();
+    std::vector<KeyedIndex> items(count);
+    uint64_t anyBits = 0, allBits = ~uint64_t(0);
+    for (size_t i = 0; i < count; i++) {
+        items[i] = KeyedIndex{keys[i], static_cast<uint32_t>(i)};
+        anyBits |= keys[i];
+        allBits &= keys[i];
+    }
+
+    if (count < SmallSortSize) {
+        std::stable_sort(items.begin(), items.end(), [](const KeyedIndex &a, const KeyedIndex &b) { return a.key < b.key; });
+    } else {
+        size_t threads = 1;
+        if (count >= ParallelSortSize) {
+            size_t available = maxThreads != 0 ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+            threads = std::min(MaxSortThreads, available);
+        }
+        // digits every key shares would not move anything
+        uint64_t varying = anyBits ^ allBits;
+        std::vector<int> shifts;
+        for (int shift = 0; shift < 64; shift += DigitBits) {
+            if (((varying >> shift) & (Buckets - 1)) != 0) {
+                shifts.push_back(shift);
+            }
+        }
+
+        size_t chunkSize = (count + threads - 1) / threads;
+        // counts[t][digit] of chunk t in the current pass, next[t][digit] its next output position
+        std::vector<std::vector<size_t>> counts(threads, std::vector<size_t>(Buckets));
+        std::vector<std::vector<size_t>> next(threads, std::vector<size_t>(Buckets));
+        std::vector<KeyedIndex> scratch(count);
+        Barrier barrier(threads);
+        // Each thread runs every pass over its own chunk, started once per sort. The first
+        // barrier publishes the pass's histograms, the second ends its scatter.
+        auto sortChunk = [&](size_t t) {
+            KeyedIndex *from = items.data();
+            KeyedIndex *to = scratch.data();
+            size_t begin = std::min(count, t * chunkSize), end = std::min(count, (t + 1) * chunkSize);
+            std::vector<size_t> &chunkCounts = counts[t];
+            std::vector<size_t> &position = next[t];
+            for (int shift : shifts) {
+                std::fill(chunkCounts.begin(), chunkCounts.end(), 0);
+                for (size_t i = begin; i < end; i++) {
+                    chunkCounts[(from[i].key >> shift) & (Buckets - 1)]++;
+                }
+                barrier.wait();
+                // digit major, chunk minor, so equal digits keep their order across chunks
+                size_t before = 0;
+                for (size_t digit = 0; digit < Buckets; digit++) {
+                    for (size_t u = 0; u < threads; u++) {
+                        if (u == t) {
+                            position[digit] = before;
+                        }
+                        before += counts[u][digit];
+                    }
+                }
+                for (size_t i = begin; i < end; i++) {
+                    to[position[(from[i].key >> shift) & (Buckets - 1)]++] = from[i];
+                }
+                barrier.wait();
+                std::swap(from, to);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; t++) {
+            workers.emplace_back(sortChunk, t);
+        }
+        sortChunk(0);
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        // passes alternate between the two buffers
+        if (shifts.size() % 2 == 1) {
+            items.swap(scratch);
+        }
+    }
+
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = items[i].index;
+    }
+    return order;
+}
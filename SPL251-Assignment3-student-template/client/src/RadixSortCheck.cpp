@@ -0,0 +1,61 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <climits>
+#include <cstdint>
+#include "../include/RadixSort.h"
+
+using namespace std;
+
+/**
+* Correctness check for radixOrder, built and run by "make test".
+* Usage: RadixSortCheck
+* Compares radixOrder against std::stable_sort on random keys and exits with 1 on the first mismatch.
+*/
+
+// radixOrder must give the order std::stable_sort gives by (date_time, rank), around the
+// stable_sort and parallel thresholds, single threaded and on several threads
+static bool checkRadixOrder() {
+    mt19937 random(12345);
+    const vector<size_t> sizes = {0, 1, 255, 256, 257, 4096, 256 * 1024 - 1, 256 * 1024, 256 * 1024 + 1};
+    // full int range, a narrow range around 0 for many duplicates, and a single value
+    const vector<pair<int, int>> dateRanges = {{INT_MIN, INT_MAX}, {-50, 50}, {-7, -7}};
+    for (size_t size : sizes) {
+        for (const pair<int, int> &range : dateRanges) {
+            uniform_int_distribution<int> dateTimes(range.first, range.second);
+            uniform_int_distribution<uint32_t> ranks(0, 3);
+            vector<int> dates(size);
+            vector<uint32_t> rankOf(size);
+            vector<uint64_t> keys(size);
+            for (size_t i = 0; i < size; i++) {
+                dates[i] = dateTimes(random);
+                rankOf[i] = ranks(random);
+                keys[i] = dateTimeKey(dates[i], rankOf[i]);
+            }
+            vector<uint32_t> expected(size);
+            for (size_t i = 0; i < size; i++) {
+                expected[i] = static_cast<uint32_t>(i);
+            }
+            stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) {
+                return dates[a] != dates[b] ? dates[a] < dates[b] : rankOf[a] < rankOf[b];
+            });
+            for (size_t threads : {size_t(1), size_t(0), size_t(3), size_t(8)}) {
+                if (radixOrder(keys, threads) != expected) {
+                    cerr << "[ERROR] radixOrder differs from stable_sort: " << size << " keys, date_time in ["
+                         << range.first << ", " << range.second << "], " << threads << " threads" << endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    if (!checkRadixOrder()) {
+        return 1;
+    }
+    cout << "radixOrder matches stable_sort" << endl;
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include "../include/StandingQueries.h"
+#include "../include/StringInterner.h"
+#include "../include/TextIndex.h"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+namespace {
+
+// splits on whitespace, a double quoted part may hold spaces and loses its quotes
+bool splitWords(const std::string &text, std::vector<std::string> &words, std::string &error) {
+    std::string word;
+    bool inWord = false, quoted = false;
+    for (char c : text) {
+        if (c == '"') {
+            quoted = !quoted;
+            inWord = true;
+        } else if (!quoted && (c == ' ' || c == '\t')) {
+            if (inWord) {
+                words.push_back(word);
+                word.clear();
+                inWord = false;
+            }
+        } else {
+            word.push_back(c);
+            inWord = true;
+        }
+    }
+    if (quoted) {
+        error = "Unterminated quote";
+        return false;
+    }
+    if (inWord) {
+        words.push_back(word);
+    }
+    return true;
+}
+
+bool parseDateTime(const std::string &value, int &dateTime) {
+    try {
+        size_t used = 0;
+        long long parsed = std::stoll(value, &used);
+        if (used != value.size() || parsed < INT_MIN || parsed > INT_MAX) {
+            return false;
+        }
+        dateTime = static_cast<int>(parsed);
+        return true;
+    } catch (const std::exception &) {
+        return false;
+    }
+}
+
+// true if text holds word as a whole word under TextIndex::tokenize rules, word being one of
+// its tokens; compares in place instead of tokenizing text
+bool containsWord(const std::string &text, const std::string &word) {
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (!TextIndex::isWordByte(c)) {
+            i++;
+            continue;
+        }
+        size_t length = 0;
+        bool same = true;
+        for (; i < text.size() && TextIndex::isWordByte(c = static_cast<unsigned char>(text[i])); i++, length++) {
+            same = same && length < word.size() && TextIndex::foldWordByte(c) == word[length];
+        }
+        if (same && length == word.size()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool StandingQueries::Program::matches(const Event &event) const {
+    if (code.empty()) {
+        return true;
+    }
+    size_t i = 0;
+    while (i < code.size()) {
+        const Instruction &instruction = code[i];
+        bool holds = false;
+        switch (instruction.op) {
+        case Instruction::UserIs:
+            holds = instruction.id != NoId ? event.getEventOwnerUserId() == instruction.id
+                                           : event.getEventOwnerUser() == instruction.text;
+            break;
+        case Instruction::CityIs:
+            holds = instruction.id != NoId ? event.get_city_id() == instruction.id : event.get_city() == instruction.text;
+            break;
+        case Instruction::EventIs:
+            holds = event.get_name() == instruction.text;
+            break;
+        case Instruction::HasWord:
+            holds = containsWord(event.get_name(), instruction.text) || containsWord(event.get_description(), instruction.text);
+            break;
+        case Instruction::FlagsSet:
+            holds = (event.get_flags() & instruction.number) == instruction.number;
+            break;
+        case Instruction::FlagsClear:
+            holds = (event.get_flags() & instruction.number) == 0;
+            break;
+        case Instruction::From:
+            holds = event.get_date_time() >= instruction.number;
+            break;
+        case Instruction::To:
+            holds = event.get_date_time() <= instruction.number;
+            break;
+        }
+        if (holds) {
+            // the last clause of a group passing means the whole group did
+            if (++i == code.size() || code[i - 1].next == i) {
+                return true;
+            }
+        } else {
+            i = instruction.next;
+        }
+    }
+    return false;
+}
+
+StandingQueries::StandingQueries() : mutex(), queries(std::make_shared<QuerySet>()), sink() {}
+
+void StandingQueries::setSink(const Sink &newSink) {
+    sink = newSink;
+}
+
+void StandingQueries::publish(std::unique_ptr<QuerySet> updated) {
+    updated->byChannel.clear();
+    updated->onAnyChannel.clear();
+    for (const auto &query : updated->byName) {
+        const std::shared_ptr<const Program> &program = query.second;
+        if (program->anyChannel) {
+            updated->onAnyChannel.push_back(program);
+        } else {
+            updated->byChannel[program->channel].push_back(program);
+            updated->byChannel["/" + program->channel].push_back(program);
+        }
+    }
+    std::atomic_store(&queries, std::shared_ptr<const QuerySet>(std::move(updated)));
+}
+
+bool StandingQueries::add(const std::string &name, const std::string &condition, std::string &error) {
+    std::vector<std::string> words;
+    if (!splitWords(condition, words, error)) {
+        return false;
+    }
+    if (words.empty()) {
+        error = "Missing channel";
+        return false;
+    }
+
+    auto program = std::make_shared<Program>();
+    program->name = name;
+    program->condition = condition;
+    std::vector<Instruction> &code = program->code;
+    size_t groupStart = 0;
+    // points the clauses of the group that just ended at the first clause of the next one
+    auto closeGroup = [&]() {
+        if (code.size() == groupStart) {
+            return false;
+        }
+        for (size_t i = groupStart; i < code.size(); i++) {
+            code[i].next = static_cast<uint16_t>(code.size());
+        }
+        groupStart = code.size();
+        return true;
+    };
+    for (size_t i = 1; i < words.size(); i++) {
+        const std::string &word = words[i];
+        size_t equals = word.find('=');
+        std::string key = word.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : word.substr(equals + 1);
+        int dateTime = 0;
+        if (word == "or") {
+            if (!closeGroup()) {
+                error = "Empty clause group before or";
+                return false;
+            }
+        } else if (word == "active" || word == "forces") {
+            code.emplace_back(Instruction::FlagsSet, 0, word == "active" ? Event::ActiveFlag : Event::ForcesArrivalFlag, "");
+        } else if (word == "inactive") {
+            code.emplace_back(Instruction::FlagsClear, 0, Event::ActiveFlag, "");
+        } else if (equals == std::string::npos || value.empty()) {
+            error = "Unknown clause: " + word;
+            return false;
+        } else if (key == "user" || key == "city") {
+            // a value nobody has sent yet is compared as text
+            uint32_t id = NoId;
+            StringInterner::instance().find(value, id);
+            code.emplace_back(key == "user" ? Instruction::UserIs : Instruction::CityIs, id, 0, value);
+        } else if (key == "event") {
+            code.emplace_back(Instruction::EventIs, 0, 0, value);
+        } else if (key == "text") {
+            std::vector<std::string> tokens;
+            TextIndex::tokenize(value.data(), value.size(), tokens);
+            if (tokens.empty()) {
+                error = "No word in clause: " + word;
+                return false;
+            }
+            for (const std::string &token : tokens) {
+                code.emplace_back(Instruction::HasWord, 0, 0, token);
+            }
+        } else if ((key == "from" || key == "to") && parseDateTime(value, dateTime)) {
+            code.emplace_back(key == "from" ? Instruction::From : Instruction::To, 0, dateTime, "");
+        } else {
+            error = "Unknown clause: " + word;
+            return false;
+        }
+        if (code.size() > UINT16_MAX) {
+            error = "Condition too long";
+            return false;
+        }
+    }
+    if (!closeGroup() && !code.empty()) {
+        error = "Empty clause group after or";
+        return false;
+    }
+    program->anyChannel = words[0] == "*";
+    if (!program->anyChannel) {
+        program->channel = !words[0].empty() && words[0][0] == '/' ? words[0].substr(1) : words[0];
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<QuerySet> updated(new QuerySet(*queries));
+    updated->byName[name] = program;
+    publish(std::move(updated));
+    return true;
+}
+
+bool StandingQueries::remove(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queries->byName.count(name) == 0) {
+        return false;
+    }
+    std::unique_ptr<QuerySet> updated(new QuerySet(*queries));
+    updated->byName.erase(name);
+    publish(std::move(updated));
+    return true;
+}
+
+std::vector<std::pair<std::string, std::string>> StandingQueries::list() const {
+    std::vector<std::pair<std::string, std::string>> names;
+    std::shared_ptr<const QuerySet> current = std::atomic_load(&queries);
+    for (const auto &query : current->byName) {
+        names.emplace_back(query.first, query.second->condition);
+    }
+    return names;
+}
+
+size_t StandingQueries::evaluate(const std::string &channel, const Event &event) const {
+    std::shared_ptr<const QuerySet> current = std::atomic_load(&queries);
+    if (current->byName.empty()) {
+        return 0;
+    }
+    size_t matched = 0;
+    auto run = [&](const std::vector<std::shared_ptr<const Program>> &programs) {
+        for (const std::shared_ptr<const Program> &program : programs) {
+            if (program->matches(event)) {
+                matched++;
+                if (sink) {
+                    sink(program->name, channel, event);
+                }
+            }
+        }
+    };
+    // a channel without queries of its own is simply not listed
+    auto it = current->byChannel.find(channel);
+    if (it != current->byChannel.end()) {
+        run(it->second);
+    }
+    run(current->onAnyChannel);
+    return matched;
+}
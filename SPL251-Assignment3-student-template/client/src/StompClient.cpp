@@ -2,10 +2,34 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
+#include <ctime>
+#include <climits>
+#include <cstdint>
+#include <glob.h>
 #include "StompProtocol.h" 
 
 using namespace std;
 
+// a plain decimal number no larger than max; a sign, any other character or overflow fails
+static bool parseUnsigned(const string& text, unsigned long long max, unsigned long long& value) {
+    if (text.empty()) {
+        return false;
+    }
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        unsigned digit = static_cast<unsigned>(c - '0');
+        if (value > (max - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     cout << "[INFO] Welcome to StompEMIClient!" << endl;
 
@@ -90,28 +114,283 @@ int main(int argc, char* argv[]) {
                     continue;
                 }
 
-                string filePath;
-                ss >> filePath;
-                if (filePath.empty()) {
-                    cerr << "[ERROR] No file path specified. Use: report <file_path>" << endl;
+                // every argument is a file or a glob pattern
+                vector<string> filePaths;
+                string pattern;
+                while (ss >> pattern) {
+                    glob_t matches;
+                    if (pattern.find_first_of("*?[") != string::npos && glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+                        for (size_t i = 0; i < matches.gl_pathc; i++) {
+                            filePaths.push_back(matches.gl_pathv[i]);
+                        }
+                        globfree(&matches);
+                    } else {
+                        filePaths.push_back(pattern);
+                    }
+                }
+                if (filePaths.empty()) {
+                    cerr << "[ERROR] No file path specified. Use: report <file_path|glob>..." << endl;
                     continue;
                 }
 
-                protocol->reportEvents(filePath);
+                protocol->reportEvents(filePaths);
             } else if (command == "summary") {
                 if (!protocol) {
                     cerr << "[ERROR] Not logged in. Please login first." << endl;
                     continue;
                 }
 
+                const char* summaryUsage = "summary <channel> <user> <file_path> [async|incremental] [from=<date_time>] [to=<date_time>] "
+                                           "[last=<seconds>] [city=<name>] [active] [forces]";
                 string channel, user, filePath;
                 ss >> channel >> user >> filePath;
                 if (channel.empty() || user.empty() || filePath.empty()) {
-                    cerr << "[ERROR] Missing arguments. Use: summary <channel> <user> <file_path>" << endl;
+                    cerr << "[ERROR] Missing arguments. Use: " << summaryUsage << endl;
+                    continue;
+                }
+
+                // options: async or incremental, from=<date_time>, to=<date_time>, last=<seconds> before the
+                // channel's newest event, city=<name> (quoted if it has spaces), active, forces
+                StompProtocol::SummaryMode mode = StompProtocol::RewriteSummary;
+                SummaryFilter filter;
+                string option, error;
+                try {
+                    while (error.empty() && ss >> option) {
+                        if (option == "async" || option == "incremental") {
+                            if (mode != StompProtocol::RewriteSummary) {
+                                error = "Only one of async and incremental can be given";
+                            }
+                            mode = option == "async" ? StompProtocol::AsyncSummary : StompProtocol::IncrementalSummary;
+                        } else if (option == "active") {
+                            filter.flags |= Event::ActiveFlag;
+                        } else if (option == "forces") {
+                            filter.flags |= Event::ForcesArrivalFlag;
+                        } else if (option.compare(0, 5, "from=") == 0) {
+                            filter.from = stoi(option.substr(5));
+                        } else if (option.compare(0, 3, "to=") == 0) {
+                            filter.to = stoi(option.substr(3));
+                        } else if (option.compare(0, 5, "last=") == 0) {
+                            unsigned long long seconds = 0;
+                            if (!parseUnsigned(option.substr(5), INT_MAX, seconds)) {
+                                error = "Invalid number in summary option: " + option;
+                            }
+                            filter.last = static_cast<int>(seconds);
+                        } else if (option.compare(0, 5, "city=") == 0) {
+                            string city = option.substr(5);
+                            if (!city.empty() && city[0] == '"') {
+                                string word;
+                                while ((city.size() < 2 || city.back() != '"') && ss >> word) {
+                                    city += " " + word;
+                                }
+                                if (city.size() < 2 || city.back() != '"') {
+                                    error = "Unterminated city name";
+                                }
+                                city = city.substr(1, city.size() - 2);
+                            }
+                            filter.byCity = true;
+                            filter.city = city;
+                        } else {
+                            error = "Unknown summary option: " + option;
+                        }
+                    }
+                } catch (const exception&) {
+                    error = "Invalid number in summary option: " + option;
+                }
+                if (!error.empty()) {
+                    cerr << "[ERROR] " << error << ". Use: " << summaryUsage << endl;
+                    continue;
+                }
+
+                protocol->generateSummary(channel, user, filePath, mode, filter);
+            } else if (command == "summary-all") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                string directory;
+                ss >> directory;
+                if (directory.empty()) {
+                    cerr << "[ERROR] No directory specified. Use: summary-all <directory>" << endl;
+                    continue;
+                }
+
+                protocol->generateAllSummaries(directory);
+            } else if (command == "stats") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                string channel, user;
+                ss >> channel >> user;
+                if (channel.empty() || user.empty()) {
+                    cerr << "[ERROR] Missing arguments. Use: stats <channel> <user>" << endl;
+                    continue;
+                }
+
+                protocol->printStats(channel, user);
+            } else if (command == "search") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                // terms are ANDed, OR starts another group of terms; both words are keywords, not terms
+                string channel, term, queryText;
+                ss >> channel;
+                TextQuery query(1);
+                while (ss >> term) {
+                    queryText += (queryText.empty() ? "" : " ") + term;
+                    if (term == "OR") {
+                        query.emplace_back();
+                    } else if (term != "AND") {
+                        query.back().push_back(term);
+                    }
+                }
+                bool emptyGroup = false;
+                for (const vector<string>& group : query) {
+                    emptyGroup = emptyGroup || group.empty();
+                }
+                if (channel.empty() || emptyGroup) {
+                    cerr << "[ERROR] Missing arguments. Use: search <channel> <term>... [OR <term>...]... "
+                            "(terms are ANDed, a literal AND is ignored and OR is a keyword, so neither is searched for)"
+                         << endl;
+                    continue;
+                }
+
+                protocol->searchEvents(channel, query, queryText);
+            } else if (command == "trend") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                // windows are a count and a unit, m, h or d; a few standard ones if none given
+                const char* trendUsage = "trend channel|city <name> [<count>m|h|d]...";
+                string kind, name, window, error;
+                ss >> kind >> name;
+                if ((kind != "channel" && kind != "city") || name.empty()) {
+                    cerr << "[ERROR] Missing arguments. Use: " << trendUsage << endl;
+                    continue;
+                }
+                if (kind == "city" && name[0] == '"') {
+                    string word;
+                    while ((name.size() < 2 || name.back() != '"') && ss >> word) {
+                        name += " " + word;
+                    }
+                    name = name.size() >= 2 && name.back() == '"' ? name.substr(1, name.size() - 2) : "";
+                }
+                vector<pair<TimeBuckets::Resolution, size_t>> windows;
+                while (error.empty() && ss >> window) {
+                    size_t digits = window.find_first_not_of("0123456789");
+                    string unit = digits == string::npos ? "" : window.substr(digits);
+                    TimeBuckets::Resolution resolution = unit == "m"   ? TimeBuckets::Minute
+                                                         : unit == "h" ? TimeBuckets::Hour
+                                                                       : TimeBuckets::Day;
+                    size_t count = digits == 0 || digits > 9 ? 0 : stoul(window.substr(0, digits));
+                    if ((unit != "m" && unit != "h" && unit != "d") || count == 0) {
+                        error = "Invalid window: " + window;
+                    } else if (count > TimeBuckets::capacity(resolution)) {
+                        error = "Window " + window + " is longer than the " +
+                                to_string(TimeBuckets::capacity(resolution)) + unit + " kept";
+                    } else {
+                        windows.emplace_back(resolution, count);
+                    }
+                }
+                if (name.empty()) {
+                    error = "Unterminated city name";
+                }
+                if (!error.empty()) {
+                    cerr << "[ERROR] " << error << ". Use: " << trendUsage << endl;
                     continue;
                 }
+                if (windows.empty()) {
+                    windows = {{TimeBuckets::Minute, 5}, {TimeBuckets::Hour, 1}, {TimeBuckets::Hour, 24}, {TimeBuckets::Day, 7}};
+                }
 
-                protocol->generateSummary(channel, user, filePath);
+                protocol->printTrend(kind == "city", name, windows);
+            } else if (command == "watch" || command == "unwatch") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                // watch alone lists the standing queries
+                string name, condition;
+                ss >> name;
+                getline(ss >> ws, condition);
+                if (command == "watch" && name.empty()) {
+                    protocol->listWatches();
+                } else if (command == "unwatch" && !name.empty()) {
+                    protocol->removeWatch(name);
+                } else if (command == "watch" && !condition.empty()) {
+                    protocol->addWatch(name, condition);
+                } else {
+                    cerr << "[ERROR] Missing arguments. Use: watch [<name> <channel|*> [<clause>... [or <clause>...]]] "
+                            "or unwatch <name>" << endl;
+                }
+            } else if (command == "snapshot" || command == "restore") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                string filePath;
+                ss >> filePath;
+                if (filePath.empty()) {
+                    cerr << "[ERROR] No file path specified. Use: " << command << " <file_path>" << endl;
+                    continue;
+                }
+                if (command == "snapshot") {
+                    protocol->saveSnapshot(filePath);
+                } else {
+                    protocol->restoreSnapshot(filePath);
+                }
+            } else if (command == "eventlog") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                string directory;
+                ss >> directory;
+                if (directory.empty()) {
+                    cerr << "[ERROR] No directory specified. Use: eventlog <directory|off>" << endl;
+                    continue;
+                }
+                if (directory == "off") {
+                    protocol->closeEventLog();
+                } else {
+                    protocol->openEventLog(directory);
+                }
+            } else if (command == "retention") {
+                if (!protocol) {
+                    cerr << "[ERROR] Not logged in. Please login first." << endl;
+                    continue;
+                }
+
+                // no arguments shows the current state, 0 disables a limit
+                vector<string> limits;
+                string limit;
+                while (ss >> limit) {
+                    limits.push_back(limit);
+                }
+                if (limits.empty()) {
+                    protocol->logRetentionStats();
+                    continue;
+                }
+                unsigned long long maxEvents, maxAge, maxBytes;
+                if (limits.size() != 3 || !parseUnsigned(limits[0], SIZE_MAX, maxEvents) ||
+                    !parseUnsigned(limits[1], INT_MAX, maxAge) || !parseUnsigned(limits[2], SIZE_MAX, maxBytes)) {
+                    cerr << "[ERROR] Invalid arguments. Use: retention [<max_events_per_channel> <max_age_seconds> <max_live_payload_bytes>]" << endl;
+                    continue;
+                }
+                RetentionPolicy policy;
+                policy.maxEventsPerChannel = static_cast<size_t>(maxEvents);
+                policy.maxAge = static_cast<int>(maxAge);
+                policy.maxBytes = static_cast<size_t>(maxBytes);
+                protocol->setRetention(policy);
             } else if (command == "exit") {
                  if (!protocol) {
                     cerr << "[ERROR] Not logged in. Please login first." << endl;
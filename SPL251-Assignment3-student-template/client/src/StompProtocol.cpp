@@ -1,13 +1,156 @@
 #include "StompProtocol.h"
+#include "DateFormatter.h"
+#include "RadixSort.h"
+#include "EventsFileReader.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <algorithm>
 #include <chrono>
-#include <iomanip>
+#include <queue>
+#include <set>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <cerrno>
+#include <sys/stat.h>
 
 using namespace std;
 
+// Where an incremental summary file left off: the (date_time, name) key of its last row,
+// how many rows with exactly that key it holds, its header and size when written and the
+// filter its rows were selected with
+struct SummaryWatermark {
+    std::string channel;
+    std::string user;
+    int dateTime;
+    std::string name;
+    size_t equalRows;
+    SummaryCounts counts;
+    size_t fileSize;
+    SummaryFilter filter;
+
+    SummaryWatermark() : channel(), user(), dateTime(0), name(), equalRows(0), counts(), fileSize(0), filter() {}
+};
+
+namespace {
+
+// mkdir -p, false if some component could not be created
+bool makeDirectories(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (!prefix.empty() && ::mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+bool fileSizeOf(const std::string& path, size_t& size) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+bool sameFilter(const SummaryFilter& a, const SummaryFilter& b) {
+    return a.from == b.from && a.to == b.to && a.byCity == b.byCity && (!a.byCity || a.city == b.city) &&
+           a.flags == b.flags;
+}
+
+// false if the watermark is missing, unreadable, from an older version or the summary file changed since
+bool loadWatermark(const std::string& path, const std::string& summaryPath, SummaryWatermark& watermark) {
+    std::ifstream in(path);
+    int version = 0;
+    int flags = 0;
+    size_t summarySize;
+    if (!(in >> version >> watermark.fileSize >> watermark.counts.total >> watermark.counts.active >>
+          watermark.counts.forcesArrival >> watermark.dateTime >> watermark.equalRows) || version != 2 ||
+        !(in >> watermark.filter.from >> watermark.filter.to >> watermark.filter.byCity >> flags)) {
+        return false;
+    }
+    watermark.filter.flags = static_cast<uint8_t>(flags);
+    in.ignore(1);
+    return std::getline(in, watermark.filter.city) && std::getline(in, watermark.channel) &&
+           std::getline(in, watermark.user) && std::getline(in, watermark.name) &&
+           fileSizeOf(summaryPath, summarySize) && summarySize == watermark.fileSize;
+}
+
+bool saveWatermark(const std::string& path, const SummaryWatermark& watermark) {
+    std::ofstream out(path, std::ios::trunc);
+    out << 2 << "\n" << watermark.fileSize << "\n" << watermark.counts.total << " " << watermark.counts.active << " "
+        << watermark.counts.forcesArrival << "\n" << watermark.dateTime << " " << watermark.equalRows << "\n"
+        << watermark.filter.from << " " << watermark.filter.to << " " << watermark.filter.byCity << " "
+        << static_cast<int>(watermark.filter.flags) << "\n" << watermark.filter.city << "\n"
+        << watermark.channel << "\n" << watermark.user << "\n" << watermark.name << "\n";
+    return static_cast<bool>(out);
+}
+
+// moves the watermark past rows, which follow it in (date_time, name) order
+void advanceWatermark(SummaryWatermark& watermark, std::vector<EventRow>::const_iterator first,
+                      std::vector<EventRow>::const_iterator last) {
+    for (; first != last; ++first) {
+        const std::string& name = internedString(first->name);
+        if (first->dateTime == watermark.dateTime && name == watermark.name) {
+            watermark.equalRows++;
+        } else {
+            watermark.dateTime = first->dateTime;
+            watermark.name = name;
+            watermark.equalRows = 1;
+        }
+        watermark.counts.add(first->flags);
+    }
+}
+
+// One file of a report: its events staged for the store and, in send order, the date_time
+// and file position of each of them
+struct ReportedFile {
+    std::unique_ptr<EventsFile> file;
+    std::string channelName;
+    EventStore::Staged events;
+    std::vector<std::pair<int, size_t>> sendOrder;
+    std::string error;
+
+    ReportedFile() : file(), channelName(), events(), sendOrder(), error() {}
+};
+
+// runs work(i) for every i below count, spread over up to one thread per core, the caller included
+void forEachOnWorkers(size_t count, const std::function<void(size_t)>& work) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            work(i);
+        }
+    };
+    size_t workerCount = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+// A channel or user name as one path component: '/' becomes '_' and a leading '.' is
+// escaped as "_.", so neither "." nor ".." nor a slash can leave the summary directory.
+// Empty names have no file name and are rejected.
+bool pathComponentOf(const std::string& name, std::string& component) {
+    if (name.empty()) {
+        return false;
+    }
+    component = name[0] == '.' ? "_" + name : name;
+    std::replace(component.begin(), component.end(), '/', '_');
+    return true;
+}
+
+} // namespace
+
 StompProtocol::StompProtocol(const std::string& host, int port)
     : connectionHandler(host, port),
       isConnected(false),
@@ -16,7 +159,16 @@ StompProtocol::StompProtocol(const std::string& host, int port)
       receiptID(0),
       subscriptions(),
       Events(),
-      frameCreator() {}
+      eventLog(),
+      frameCreator(),
+      standingQueries(),
+      lazyEventParsing(true),
+      summaryWriter() {
+    standingQueries.setSink([this](const std::string& query, const std::string& channel, const Event& event) {
+        logMessage("ALERT", "Watch " + query + " matched in channel " + channel + ": " + epochToDate(event.get_date_time()) +
+                            " - " + event.get_name() + " - " + event.get_city() + " (" + event.getEventOwnerUser() + ")");
+    });
+}
 
 StompProtocol::~StompProtocol() {
     disconnectFromServer();
@@ -25,9 +177,8 @@ StompProtocol::~StompProtocol() {
 std::string StompProtocol::getCurrentTimestamp() {
     auto now = std::chrono::system_clock::now();
     auto time = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+    char buffer[DateFormatter::LongCapacity];
+    return std::string(buffer, DateFormatter::local().formatLong(time, buffer));
 }
 
 void StompProtocol::logMessage(const std::string& level, const std::string& message) {
@@ -100,6 +251,9 @@ void StompProtocol::disconnectFromServer() {
         std::lock_guard<std::mutex> subLock(subscriptionsMutex);
         subscriptions.clear();
     }
+    // every channel's arena goes back in one piece
+    Events.clear();
+    eventLog.sync();
     username.clear();
     logMessage("INFO", "User session disconnected.");
 }
@@ -147,18 +301,20 @@ void StompProtocol::unsubscribeFromTopic(const std::string& destination) {
 
     if (connectionHandler.sendFrameAscii(unsubscribeFrame, '\0')) {
         subscriptions.erase(it);
+        // drop what was received on the channel and what was reported to it
+        Events.dropChannel(destination);
+        Events.dropChannel(!destination.empty() && destination[0] == '/' ? destination.substr(1) : "/" + destination);
         logMessage("INFO", "Unsubscribed from: " + destination);
     } else {
         logMessage("ERROR", "Failed to unsubscribe from topic: " + destination);
     }
 }
+
 Event StompProtocol::parseEvent(const std::string& message) {
-    // Define variables to hold the parsed data
-    std::string city, name, description, channel, eventOwner;
-    std::time_t date_time = 0;
-    bool isActive = false, forcesArrival = false;
-    std::map<std::string, std::string> additionalInfo;
+    return parseEvent(message, frameCreator.parseMessage(message));
+}
 
+Event StompProtocol::parseEvent(const std::string& message, const std::map<std::string, std::string>& headers) {
     // Helper function to extract a field value by searching for the field name
     auto extractValueFromMessage = [](const std::string& msg, const std::string& fieldName) -> std::string {
         size_t fieldPos = msg.find(fieldName);
@@ -170,12 +326,8 @@ Event StompProtocol::parseEvent(const std::string& message) {
         return "";
     };
 
-    // Parse city, event name, description, date_time, and channel information from the message
-    city = extractValueFromMessage(message, "city:");
-    name = extractValueFromMessage(message, "event name:");
-    description = extractValueFromMessage(message, "description:");
-
     // Parse event date_time (ensure valid format)
+    std::time_t date_time = 0;
     std::string dateTimeStr = extractValueFromMessage(message, "date time:");
     if (!dateTimeStr.empty()) {
         try {
@@ -185,41 +337,23 @@ Event StompProtocol::parseEvent(const std::string& message) {
         }
     }
 
-    // Parse active and forces arrival flags
-    isActive = (message.find("active:true") != std::string::npos);
-    forcesArrival = (message.find("forces_arrival_at_scene:true") != std::string::npos);
-
-    // Add active and forces arrival to additionalInfo
-    additionalInfo["active"] = isActive ? "true" : "false";
-    additionalInfo["forces_arrival_at_scene"] = forcesArrival ? "true" : "false";
-
-    // Extract general information if it exists
-    std::string generalInfoSection = extractValueFromMessage(message, "general information:");
-    if (!generalInfoSection.empty()) {
-        std::istringstream infoStream(generalInfoSection);
-        std::string line;
-        while (std::getline(infoStream, line)) {
-            size_t delimiterPos = line.find(':');
-            if (delimiterPos != std::string::npos) {
-                std::string key = line.substr(0, delimiterPos);
-                std::string value = line.substr(delimiterPos + 1);
-                additionalInfo[key] = value;
-            }
-        }
-    }
-
-    // Parse destination (channel)
-    channel = extractValueFromMessage(message, "destination:");
+    // The frame is indexed once, city, description and general information wait in it
+    // until something reads them unless lazy parsing is off
+    auto destination = headers.find("destination");
+    Event parsedEvent(message, destination != headers.end() ? destination->second : "", static_cast<int>(date_time),
+                      lazyEventParsing);
 
     // Extract event owner user information from headers (if available)
-    std::map<std::string, std::string> headers = frameCreator.parseMessage(message);
-    eventOwner = headers.find("user") != headers.end() ? headers["user"] : "";
-    Event parsedEvent(channel, city, name, date_time, description, additionalInfo);
-    parsedEvent.setEventOwnerUser(eventOwner);
+    auto user = headers.find("user");
+    parsedEvent.setEventOwnerUser(user != headers.end() ? user->second : "");
 
     return parsedEvent;
 }
 
+void StompProtocol::setLazyEventParsing(bool lazy) {
+    lazyEventParsing = lazy;
+}
+
 
 
 void StompProtocol::handleReceivedMessage(const std::string& message) {
@@ -266,12 +400,13 @@ void StompProtocol::handleReceivedMessage(const std::string& message) {
             std::map<std::string, std::string> general_information;
 
             // Assume parseEventBody is a helper function to extract fields from the body
-            Event newEvent = parseEvent(message);;
+            Event newEvent = parseEvent(message, headers);
             newEvent.setEventOwnerUser(user); // Set the event owner user directly from the header
-            // Lock to ensure thread-safe modification of Events
-            {
-                std::lock_guard<std::mutex> lock(eventMutex);
-                Events[destination].push_back(newEvent);
+            standingQueries.evaluate(destination, newEvent);
+            // Only the channel's shard is locked while storing
+            Events.add(destination, newEvent);
+            if (eventLog.isOpen() && !eventLog.append(destination, newEvent)) {
+                logMessage("ERROR", "Failed to append event to log: " + eventLog.path());
             }
 
             logMessage("INFO", "Event added to channel: " + destination);
@@ -319,158 +454,586 @@ void StompProtocol::sendMessage(const std::string& destination, const std::strin
 
 
 void StompProtocol::reportEvents(const std::string& filePath) {
-    try {
-        // Parse the events file
-        names_and_events parsedData = parseEventsFile(filePath, username);
-        const std::string& channelName = parsedData.channel_name;
-        std::vector<Event>& parsedEvents = parsedData.events;
-
-        // Sort events by date and time
-        std::sort(parsedEvents.begin(), parsedEvents.end(), [](const Event& a, const Event& b) {
-            return a.get_date_time() < b.get_date_time();
-        });
-
-        // Store events by channel
-        Events[channelName] = parsedEvents;
-        std::cout << "Events stored for channel: " << channelName << std::endl;
-
-        // Loop through parsed events and send each with the correct user field
-        for (auto& event : parsedEvents) {
-            event.setEventOwnerUser(username);
-            logMessage("INFO", "User set to: " + username + " for event: " + event.get_name()); 
-
-            
-            // Construct the message body for this event
-            std::ostringstream messageBody;
-            messageBody << "user:" << username << "\n"
-                        << "channel name:" << channelName << "\n"
-                        << "city:" << event.get_city() << "\n"
-                        << "event name:" << event.get_name() << "\n"
-                        << "date time:" << event.get_date_time() << "\n"
-                        << "description:" << event.get_description() << "\n"
-                        << "general information:\n";
-
-            for (const auto& [key, value] : event.get_general_information()) {
-                messageBody << "\t" << key << ":" << value << "\n";
+    reportEvents(std::vector<std::string>{filePath});
+}
+
+void StompProtocol::reportEvents(const std::vector<std::string>& filePaths) {
+    // Every file is read on its own worker straight into a channel built aside. Of each event
+    // only its date_time and file position are kept for sending, the event itself is read
+    // again from the still open file when its turn comes.
+    std::vector<ReportedFile> reported(filePaths.size());
+    // the files already spread over the cores, each sort gets its share of them
+    size_t sortThreads = std::max<size_t>(1, std::thread::hardware_concurrency() / std::max<size_t>(1, filePaths.size()));
+    forEachOnWorkers(filePaths.size(), [&](size_t i) {
+        ReportedFile& file = reported[i];
+        try {
+            file.file.reset(new EventsFile(filePaths[i], username));
+            std::vector<uint64_t> keys;
+            std::vector<std::pair<int, size_t>> positions;
+            file.channelName = file.file->read([&](Event& event, size_t position) {
+                file.events.add(event);
+                keys.push_back(dateTimeKey(event.get_date_time(), 0));
+                positions.push_back(std::make_pair(event.get_date_time(), position));
+            });
+            // stable by date_time alone, events with the same time keep their file order
+            file.sendOrder.reserve(positions.size());
+            for (uint32_t e : radixOrder(keys, sortThreads)) {
+                file.sendOrder.push_back(positions[e]);
             }
+        } catch (const std::exception& e) {
+            file.error = e.what();
+        }
+    });
 
-            // Send the constructed message
-            sendMessage(channelName, messageBody.str());
+    // Store events by channel, a report replaces what the channel held before; several files
+    // of one channel in the same report all end up in it
+    std::set<std::string> reportedChannels;
+    for (size_t i = 0; i < filePaths.size(); i++) {
+        ReportedFile& file = reported[i];
+        if (!file.error.empty()) {
+            std::cerr << "[ERROR] Failed to process emergency file: " << filePaths[i] << ": " << file.error << "\n";
+            continue;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "[ERROR] Failed to process emergency file: " << e.what() << "\n";
+        if (reportedChannels.insert(file.channelName).second) {
+            Events.replace(file.channelName, file.events);
+        } else {
+            Events.add(file.channelName, file.events);
+        }
+        std::cout << "Events stored for channel: " << file.channelName << std::endl;
+    }
+
+    // k-way merge of the sorted files into one time ordered send stream, ties go to the earlier file
+    typedef std::pair<int, std::pair<size_t, size_t>> MergeEntry; // date_time, (file, position in sendOrder)
+    std::priority_queue<MergeEntry, std::vector<MergeEntry>, std::greater<MergeEntry>> heads;
+    for (size_t i = 0; i < reported.size(); i++) {
+        if (reported[i].error.empty() && !reported[i].sendOrder.empty()) {
+            heads.push(MergeEntry(reported[i].sendOrder[0].first, std::make_pair(i, 0)));
+        }
+    }
+
+    while (!heads.empty()) {
+        size_t index = heads.top().second.first;
+        size_t position = heads.top().second.second;
+        heads.pop();
+        ReportedFile& file = reported[index];
+        if (position + 1 < file.sendOrder.size()) {
+            heads.push(MergeEntry(file.sendOrder[position + 1].first, std::make_pair(index, position + 1)));
+        }
+        Event event = file.file->eventAt(file.sendOrder[position].second);
+
+        const std::string& channelName = file.channelName;
+        event.setEventOwnerUser(username);
+        logMessage("INFO", "User set to: " + username + " for event: " + event.get_name()); 
+
+        // Construct the message body for this event
+        std::ostringstream messageBody;
+        messageBody << "user:" << username << "\n"
+                    << "channel name:" << channelName << "\n"
+                    << "city:" << event.get_city() << "\n"
+                    << "event name:" << event.get_name() << "\n"
+                    << "date time:" << event.get_date_time() << "\n"
+                    << "description:" << event.get_description() << "\n"
+                    << "general information:\n";
+
+        for (const auto& [key, value] : event.get_general_information()) {
+            messageBody << "\t" << key << ":" << value << "\n";
+        }
+
+        // Send the constructed message
+        sendMessage(channelName, messageBody.str());
     }
 }
 
 std::string StompProtocol::epochToDate(time_t epochTime) {
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&epochTime), "%d/%m/%y %H:%M");
-    return ss.str();
+    char buffer[DateFormatter::ShortSize];
+    DateFormatter::local().formatShort(epochTime, buffer);
+    return std::string(buffer, DateFormatter::ShortSize);
 }
 
-void StompProtocol::generateSummary(const std::string& channelName, const std::string& user, const std::string& filePath) {
-    // Lock to ensure thread safety
-    std::lock_guard<std::mutex> lock(eventMutex);
+bool StompProtocol::snapshotUserRows(const std::string& channel, const std::string& user, EventSnapshot& snapshot,
+                                     const SummaryFilter& filter, bool& fromLog) {
+    // The store holds the newest rows of a channel and the event log everything received, the
+    // rows the store no longer holds come from the log and sort before all of the store's
+    fromLog = false;
+    StoreWindow window;
+    bool stored = Events.snapshotUser(channel, user, snapshot, filter, &window);
+    EventSnapshot logged;
+    if (!eventLog.isOpen() || !eventLog.snapshotUser(channel, user, logged, filter, &window) ||
+        (stored && logged.rows.empty())) {
+        return stored;
+    }
+    fromLog = true;
+    if (stored) {
+        logged.rows.insert(logged.rows.end(), snapshot.rows.begin(), snapshot.rows.end());
+        logged.counts.add(snapshot.counts);
+    }
+    logged.payload = std::make_shared<std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>>>(
+        logged.payload, snapshot.payload);
+    snapshot.rows.swap(logged.rows);
+    snapshot.counts = logged.counts;
+    snapshot.payload = logged.payload;
+    return true;
+}
 
-    // Check if the channel exists
-    auto it = Events.find(channelName);
-    if (it == Events.end()) {
+bool StompProtocol::newestDateTime(const std::string& channel, int& dateTime) {
+    return Events.newestDateTime(channel, dateTime) || (eventLog.isOpen() && eventLog.newestDateTime(channel, dateTime));
+}
+
+void StompProtocol::generateSummary(const std::string& channelName, const std::string& user, const std::string& filePath,
+                                    SummaryMode mode, const SummaryFilter& requested) {
+    // last= counts back from the newest event of the channel, with the same name fallback as
+    // below; the watermark keeps the resulting from, so a moved window rewrites the file
+    SummaryFilter filter = requested;
+    int newest;
+    if (filter.last >= 0 && (newestDateTime(channelName, newest) || newestDateTime("/" + channelName, newest) ||
+                             (!channelName.empty() && channelName[0] == '/' && newestDateTime(channelName.substr(1), newest)))) {
+        filter.from = static_cast<int>(std::max<long long>(filter.from, static_cast<long long>(newest) - filter.last));
+    }
+    filter.last = -1;
+
+    std::string finalFilePath = "../bin/" + filePath;
+    std::string watermarkPath = finalFilePath + ".watermark";
+
+    // An incremental summary with a matching watermark only renders and writes the rows after it,
+    // a different filter selected different rows and rewrites the file
+    SummaryWatermark watermark;
+    bool appending = mode == IncrementalSummary && loadWatermark(watermarkPath, finalFilePath, watermark) &&
+                     watermark.channel == channelName && watermark.user == user && sameFilter(watermark.filter, filter);
+
+    // Copy the user's rows out of the channel shard or the event log, everything below runs without holding a lock
+    bool fromLog = false;
+    auto snapshotUser = [this, &user, &filter, &fromLog](const std::string& channel, EventSnapshot& snapshot) {
+        return snapshotUserRows(channel, user, snapshot, filter, fromLog);
+    };
+    EventSnapshot snapshot;
+    if (!snapshotUser(channelName, snapshot)) {
         // Log error if the channel is not found
         logMessage("ERROR", "Channel not found: " + channelName);
 
         // First, modify channelName to add "/" at the beginning if not found
         std::string modifiedChannelName = "/" + channelName;
-        it = Events.find(modifiedChannelName);
+        bool found = snapshotUser(modifiedChannelName, snapshot);
 
-        if (it == Events.end()) {
+        if (!found) {
             // If still not found, try removing "/" from the beginning (if it exists)
             if (!channelName.empty() && channelName[0] == '/') {
                 modifiedChannelName = channelName.substr(1); // Remove the leading "/"
-                it = Events.find(modifiedChannelName);
+                found = snapshotUser(modifiedChannelName, snapshot);
             }
         }
 
-    if (it == Events.end()) {
-        // If no valid channel is found, create a new one using the last modifiedChannelName
-        logMessage("INFO", "Channel not found. Using default: " + modifiedChannelName);
-        Events[modifiedChannelName]; // This creates a new entry for the modified channelName
-        it = Events.find(modifiedChannelName); // Get the iterator to the newly added channel
+        if (!found) {
+            logMessage("INFO", "Channel not found. Using default: " + modifiedChannelName);
+            logMessage("INFO", "No events found for user: " + user + " in channel: " + channelName);
+            return;
+        }
     }
-}
 
-    const auto& events = it->second;
-
-    // Filter events for the specified user
-    std::vector<Event> userEvents;
-    for (const auto& event : events) {
-        if (event.getEventOwnerUser() == user) {
-            userEvents.push_back(event);
-        }
+    if (fromLog) {
+        logMessage("INFO", "Events of " + channelName + " no longer in memory were read from event log: " + eventLog.path());
     }
 
-    if (userEvents.empty()) {
+    // The snapshot rows are already in (date_time, name) order
+    const std::vector<EventRow>& userRows = snapshot.rows;
+    if (appending && appendSummary(finalFilePath, watermarkPath, watermark, userRows)) {
+        return;
+    }
+    if (userRows.empty()) {
         logMessage("INFO", "No events found for user: " + user + " in channel: " + channelName);
         return;
     }
 
+    // Render the whole summary into one buffer, it reaches the disk with a single write
+    std::string contents = renderSummary(channelName, user, snapshot);
+
+    if (mode == AsyncSummary) {
+        logMessage("INFO", "Summary queued for writing: " + finalFilePath);
+        summaryWriter.writeAsync(finalFilePath, std::move(contents),
+            [this](const std::string& path, SummaryWriter::Status status, std::chrono::milliseconds elapsed) {
+                logSummaryWrite(path, status, elapsed);
+            });
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    SummaryWriter::Status status = SummaryWriter::write(finalFilePath, contents);
+    logSummaryWrite(finalFilePath, status,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start));
+
+    // A full write starts the watermark of an incremental summary
+    if (mode == IncrementalSummary && status == SummaryWriter::Written) {
+        watermark = SummaryWatermark();
+        watermark.channel = channelName;
+        watermark.user = user;
+        watermark.filter = filter;
+        watermark.dateTime = userRows.front().dateTime;
+        watermark.name = internedString(userRows.front().name);
+        watermark.fileSize = contents.size();
+        advanceWatermark(watermark, userRows.begin(), userRows.end());
+        if (!saveWatermark(watermarkPath, watermark)) {
+            logMessage("ERROR", "Failed to write summary watermark: " + watermarkPath);
+        }
+    }
+}
+
+bool StompProtocol::appendSummary(const std::string& path, const std::string& watermarkPath, SummaryWatermark& watermark,
+                                  const std::vector<EventRow>& rows) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Rows before the watermark key, and as many rows with exactly that key as the file holds, are already written
+    auto first = rows.begin();
+    while (first != rows.end() && (first->dateTime < watermark.dateTime ||
+                                   (first->dateTime == watermark.dateTime && internedString(first->name) < watermark.name))) {
+        ++first;
+    }
+    for (size_t written = 0; written < watermark.equalRows && first != rows.end() &&
+                             first->dateTime == watermark.dateTime && internedString(first->name) == watermark.name;
+         written++) {
+        ++first;
+    }
+
+    // More of them than the file holds means events arrived late, at or before the watermark;
+    // appending would leave them out, so the caller rewrites the whole file
+    if (static_cast<size_t>(first - rows.begin()) > watermark.counts.total) {
+        logMessage("WARNING", "Events arrived before the summary watermark, rewriting the whole summary: " + path);
+        return false;
+    }
+    if (first == rows.end()) {
+        logMessage("INFO", "Summary already up to date: " + path);
+        return true;
+    }
+
+    std::string oldHeader = renderSummaryHeader(watermark.channel, watermark.user, watermark.counts);
+    advanceWatermark(watermark, first, rows.end());
+    std::string tail;
+    renderSummaryRows(tail, first, rows.end());
+    SummaryWriter::Status status =
+        SummaryWriter::update(path, oldHeader.size(), renderSummaryHeader(watermark.channel, watermark.user, watermark.counts), tail);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    if (status != SummaryWriter::Written) {
+        logSummaryWrite(path, status, elapsed);
+        return true;
+    }
+    if (!fileSizeOf(path, watermark.fileSize) || !saveWatermark(watermarkPath, watermark)) {
+        logMessage("ERROR", "Failed to write summary watermark: " + watermarkPath);
+        return true;
+    }
+    logMessage("INFO", "Appended " + std::to_string(rows.end() - first) + " events to summary: " + path + " (" +
+                       std::to_string(elapsed.count()) + " ms)");
+    return true;
+}
 
-    // Sort events by date and then by name
-    std::sort(userEvents.begin(), userEvents.end(), [](const Event& a, const Event& b) {
-        if (a.get_date_time() == b.get_date_time()) {
-            return a.get_name() < b.get_name();
+void StompProtocol::generateAllSummaries(const std::string& directory) {
+    auto start = std::chrono::steady_clock::now();
+    std::string finalDirectory = "../bin/" + directory;
+
+    // One pass over each channel splits its ordered rows by user, so every summary keeps the
+    // (date_time, name) order. A channel's files go to a directory named after it, channel
+    // and user names made safe by pathComponentOf, so "/police" and "police" stay apart.
+    struct SummaryJob {
+        std::string channel;
+        std::string user;
+        std::string path;
+        EventSnapshot snapshot;
+    };
+    std::vector<SummaryJob> jobs;
+    for (const std::string& channel : Events.channelNames()) {
+        EventSnapshot channelRows;
+        if (!Events.snapshotChannel(channel, channelRows)) {
+            continue;
+        }
+        std::string channelDirectory;
+        if (!pathComponentOf(channel, channelDirectory)) {
+            logMessage("WARNING", "Skipping channel with an empty name");
+            continue;
         }
-        return a.get_date_time() < b.get_date_time();
+        channelDirectory = finalDirectory + "/" + channelDirectory;
+        if (!makeDirectories(channelDirectory)) {
+            logMessage("ERROR", "Failed to create directory: " + channelDirectory);
+            continue;
+        }
+        // users whose name makes no file name map to SIZE_MAX and are skipped
+        std::unordered_map<uint32_t, size_t> jobOfUser;
+        for (const EventRow& row : channelRows.rows) {
+            auto it = jobOfUser.emplace(row.user, jobs.size());
+            if (it.second) {
+                const std::string& user = internedString(row.user);
+                std::string fileName;
+                if (!pathComponentOf(user, fileName)) {
+                    logMessage("WARNING", "Skipping events without a user in channel: " + channel);
+                    it.first->second = SIZE_MAX;
+                    continue;
+                }
+                jobs.push_back(SummaryJob{channel, user, channelDirectory + "/" + fileName + ".txt", EventSnapshot()});
+                jobs.back().snapshot.payload = channelRows.payload;
+            }
+            if (it.first->second == SIZE_MAX) {
+                continue;
+            }
+            EventSnapshot& snapshot = jobs[it.first->second].snapshot;
+            snapshot.rows.push_back(row);
+            snapshot.counts.add(row.flags);
+        }
+    }
+
+    // Render and write every summary on a worker pool
+    std::vector<SummaryWriter::Status> statuses(jobs.size(), SummaryWriter::Written);
+    forEachOnWorkers(jobs.size(), [&](size_t i) {
+        statuses[i] = SummaryWriter::write(jobs[i].path, renderSummary(jobs[i].channel, jobs[i].user, jobs[i].snapshot));
     });
 
-    // Calculate statistics
-    int totalReports = static_cast<int>(userEvents.size());
-    int activeCount = 0;
-    int forcesArrivalCount = 0;
+    size_t written = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (statuses[i] == SummaryWriter::Written) {
+            written++;
+        } else {
+            logSummaryWrite(jobs[i].path, statuses[i], std::chrono::milliseconds(0));
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    logMessage("INFO", "Wrote " + std::to_string(written) + " of " + std::to_string(jobs.size()) + " summaries to: " +
+                       finalDirectory + " in " + std::to_string(elapsed.count()) + " ms");
+}
+
+std::string StompProtocol::renderSummary(const std::string& channelName, const std::string& user, const EventSnapshot& snapshot) {
+    std::string out = renderSummaryHeader(channelName, user, snapshot.counts);
+    out += "Event Reports:\n";
+    renderSummaryRows(out, snapshot.rows.begin(), snapshot.rows.end());
+    return out;
+}
+
+std::string StompProtocol::renderSummaryHeader(const std::string& channelName, const std::string& user, const SummaryCounts& counts) {
+    return "Channel: " + channelName + "\n" +
+           "User: " + user + "\n" +
+           "Stats:\n" +
+           "Total: " + std::to_string(counts.total) + "\n" +
+           "Active: " + std::to_string(counts.active) + "\n" +
+           "Forces arrival at scene: " + std::to_string(counts.forcesArrival) + "\n\n";
+}
+
+void StompProtocol::renderSummaryRows(std::string& out, std::vector<EventRow>::const_iterator first,
+                                      std::vector<EventRow>::const_iterator last) {
+    size_t reserve = out.size();
+    for (auto row = first; row != last; ++row) {
+        reserve += 64 + row->descriptionLength;
+    }
+    out.reserve(reserve);
+
+    DateFormatter& dates = DateFormatter::local();
+    char date[DateFormatter::ShortSize];
+    for (auto it = first; it != last; ++it) {
+        const EventRow& row = *it;
+        dates.formatShort(row.dateTime, date);
+        out.append(date, DateFormatter::ShortSize);
+        out += " - ";
+        out += internedString(row.name);
+        out += " - ";
+        out += internedString(row.city);
+        out += ":\n";
+        out.append(row.description, row.descriptionLength);
+        out += "\n\n";
+    }
+}
+
+void StompProtocol::logSummaryWrite(const std::string& path, SummaryWriter::Status status, std::chrono::milliseconds elapsed) {
+    if (status == SummaryWriter::OpenFailed) {
+        logMessage("ERROR", "Failed to open file for writing: " + path);
+    } else if (status == SummaryWriter::WriteFailed) {
+        logMessage("ERROR", "Failed to write data to file: " + path);
+    } else {
+        logMessage("INFO", "Summary successfully written to: " + path + " (" + std::to_string(elapsed.count()) + " ms)");
+    }
+}
+
+
+void StompProtocol::printStats(const std::string& channelName, const std::string& user) {
+    // Same channel name fallback and sources as generateSummary: the store, plus the events
+    // the event log holds and the store does not
+    SummaryCounts counts;
+    bool fromLog = false;
+    auto countsOf = [this, &user, &counts, &fromLog](const std::string& channel) {
+        StoreWindow window;
+        bool stored = Events.countsOf(channel, user, counts, &window);
+        SummaryCounts logged;
+        if (!eventLog.isOpen() || !eventLog.countsOf(channel, user, logged, &window) || (stored && logged.total == 0)) {
+            return stored;
+        }
+        fromLog = true;
+        counts = stored ? counts : SummaryCounts();
+        counts.add(logged);
+        return true;
+    };
+    std::string channel = channelName;
+    if (!countsOf(channel)) {
+        channel = "/" + channelName;
+        if (!countsOf(channel)) {
+            channel = !channelName.empty() && channelName[0] == '/' ? channelName.substr(1) : channelName;
+            if (channel == channelName || !countsOf(channel)) {
+                logMessage("ERROR", "Channel not found: " + channelName);
+                return;
+            }
+        }
+    }
+
+    logMessage("INFO", "Stats for user: " + user + " in channel: " + channelName + " - Total: " +
+                       std::to_string(counts.total) + ", Active: " + std::to_string(counts.active) +
+                       ", Forces arrival at scene: " + std::to_string(counts.forcesArrival) +
+                       (fromLog ? " (including events read from event log: " + eventLog.path() + ")" : ""));
+}
 
-    for (const auto& event : userEvents) {
-        if (event.isActive()) {
-            activeCount++;
+void StompProtocol::searchEvents(const std::string& channelName, const TextQuery& query, const std::string& queryText) {
+    // only the first matches are logged, the count covers all of them
+    const size_t MaxLoggedMatches = 50;
+    auto start = std::chrono::steady_clock::now();
+    EventSnapshot snapshot;
+    std::string channel = channelName;
+    if (!Events.search(channel, query, snapshot)) {
+        channel = "/" + channelName;
+        if (!Events.search(channel, query, snapshot)) {
+            channel = !channelName.empty() && channelName[0] == '/' ? channelName.substr(1) : channelName;
+            if (channel == channelName || !Events.search(channel, query, snapshot)) {
+                logMessage("ERROR", "Channel not found: " + channelName);
+                return;
+            }
         }
-        if (event.forcesArrivalAtScene()) {
-            forcesArrivalCount++;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    logMessage("INFO", "Found " + std::to_string(snapshot.rows.size()) + " events in channel: " + channelName + " for: " +
+                       queryText + " (" + std::to_string(elapsed.count()) + " us)");
+    char date[DateFormatter::ShortSize];
+    for (size_t i = 0; i < snapshot.rows.size() && i < MaxLoggedMatches; i++) {
+        const EventRow& row = snapshot.rows[i];
+        DateFormatter::local().formatShort(row.dateTime, date);
+        logMessage("INFO", std::string(date, DateFormatter::ShortSize) + " - " + internedString(row.name) + " - " +
+                           internedString(row.city) + " (" + internedString(row.user) + ")");
+    }
+    if (snapshot.rows.size() > MaxLoggedMatches) {
+        logMessage("INFO", "... " + std::to_string(snapshot.rows.size() - MaxLoggedMatches) + " more");
+    }
+}
+
+void StompProtocol::printTrend(bool byCity, const std::string& name,
+                               const std::vector<std::pair<TimeBuckets::Resolution, size_t>>& windows) {
+    TimeBuckets buckets;
+    if (byCity) {
+        if (!Events.cityTrend(name, buckets)) {
+            logMessage("ERROR", "No events found for city: " + name);
+            return;
         }
+    } else if (!Events.channelTrend(name, buckets) && !Events.channelTrend("/" + name, buckets) &&
+               (name.empty() || name[0] != '/' || !Events.channelTrend(name.substr(1), buckets))) {
+        logMessage("ERROR", "Channel not found: " + name);
+        return;
+    }
+    if (buckets.empty()) {
+        logMessage("INFO", "No events in channel: " + name);
+        return;
     }
 
-    // Construct the file path and open the file for writing
-    std::string finalFilePath = "../bin/" + filePath;
+    const char* units[TimeBuckets::ResolutionCount] = {"m", "h", "d"};
+    const char* rateUnits[TimeBuckets::ResolutionCount] = {"min", "hour", "day"};
+    logMessage("INFO", std::string("Trend for ") + (byCity ? "city: " : "channel: ") + name + " up to " +
+                       epochToDate(buckets.newest()));
+    for (const auto& window : windows) {
+        TrendCounts counts = buckets.window(window.first, window.second, buckets.newest());
+        char rate[32];
+        snprintf(rate, sizeof(rate), "%.1f", static_cast<double>(counts.events) / static_cast<double>(window.second));
+        logMessage("INFO", "Last " + std::to_string(window.second) + units[window.first] + ": " +
+                           std::to_string(counts.events) + " events (" + rate + "/" + rateUnits[window.first] + "), " +
+                           std::to_string(counts.active) + " active");
+    }
+}
 
-    std::ofstream outFile(finalFilePath);
-    if (!outFile.is_open()) {
-        logMessage("ERROR", "Failed to open file for writing: " + finalFilePath);
+bool StompProtocol::addWatch(const std::string& name, const std::string& condition) {
+    std::string error;
+    if (!standingQueries.add(name, condition, error)) {
+        logMessage("ERROR", "Invalid watch " + name + ": " + error);
+        return false;
+    }
+    logMessage("INFO", "Watching " + name + ": " + condition);
+    return true;
+}
+
+void StompProtocol::removeWatch(const std::string& name) {
+    if (!standingQueries.remove(name)) {
+        logMessage("ERROR", "No watch named: " + name);
         return;
     }
+    logMessage("INFO", "Stopped watching " + name);
+}
 
-    // Write summary content to the file
-    outFile << "Channel: " << channelName << "\n";
-    outFile << "User: " << user << "\n";
-    outFile << "Stats:\n";
-    outFile << "Total: " << totalReports << "\n";
-    outFile << "Active: " << activeCount << "\n";
-    outFile << "Forces arrival at scene: " << forcesArrivalCount << "\n\n";
+void StompProtocol::listWatches() {
+    std::vector<std::pair<std::string, std::string>> watches = standingQueries.list();
+    logMessage("INFO", std::to_string(watches.size()) + " watches");
+    for (const auto& watch : watches) {
+        logMessage("INFO", watch.first + ": " + watch.second);
+    }
+}
 
-    outFile << "Event Reports:\n";
-    for (const auto& event : userEvents) {
-        outFile << epochToDate(event.get_date_time()) << " - " 
-                << event.get_name() << " - " 
-                << event.get_city() << ":\n";
-        outFile << event.get_description() << "\n\n";
+bool StompProtocol::openEventLog(const std::string& directory) {
+    if (!eventLog.open(directory)) {
+        logMessage("ERROR", "Failed to open event log: " + directory);
+        return false;
     }
+    logMessage("INFO", "Event log opened: " + directory + " (" + std::to_string(eventLog.segmentCount()) + " segments)");
+    return true;
+}
 
-    // Verify file write success
-    if (!outFile) {
-        logMessage("ERROR", "Failed to write data to file: " + finalFilePath);
-    } else {
-        logMessage("INFO", "Summary successfully written to: " + finalFilePath);
+void StompProtocol::closeEventLog() {
+    if (!eventLog.isOpen()) {
+        logMessage("ERROR", "No event log is open.");
+        return;
     }
+    eventLog.close();
+    logMessage("INFO", "Event log closed.");
+}
 
-    outFile.close();
+void StompProtocol::saveSnapshot(const std::string& filePath) {
+    auto start = std::chrono::steady_clock::now();
+    size_t events = 0;
+    if (!saveStoreSnapshot(Events, filePath, events)) {
+        logMessage("ERROR", "Failed to write snapshot: " + filePath);
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    logMessage("INFO", "Snapshot of " + std::to_string(events) + " events written to: " + filePath + " in " +
+                       std::to_string(elapsed.count()) + " ms");
+}
+
+void StompProtocol::restoreSnapshot(const std::string& filePath) {
+    auto start = std::chrono::steady_clock::now();
+    size_t events = 0;
+    if (!restoreStoreSnapshot(Events, filePath, events)) {
+        logMessage("ERROR", "Failed to restore snapshot: " + filePath);
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    logMessage("INFO", "Restored " + std::to_string(events) + " events from: " + filePath + " in " +
+                       std::to_string(elapsed.count()) + " ms");
 }
 
+void StompProtocol::setRetention(const RetentionPolicy& policy) {
+    Events.setRetention(policy);
+    logRetentionStats();
+}
+
+void StompProtocol::logRetentionStats() {
+    RetentionPolicy policy = Events.retentionPolicy();
+    RetentionStats stats = Events.retentionStats();
+    auto limit = [](long long value, const std::string& unit) {
+        return value == 0 ? std::string("unlimited") : std::to_string(value) + unit;
+    };
+
+    logMessage("INFO", "Retention: max events per channel " + limit(policy.maxEventsPerChannel, "") +
+                       ", max age " + limit(policy.maxAge, "s") + ", live payload budget " +
+                       limit(policy.maxBytes, " bytes"));
+    logMessage("INFO", "Stored: " + std::to_string(stats.events) + " events in " + std::to_string(stats.channels) +
+                       " channels, " + std::to_string(stats.bytes) + " live payload bytes, " +
+                       std::to_string(StringInterner::instance().size()) + " interned strings (not budgeted)");
+    logMessage("INFO", "Evicted: " + std::to_string(stats.evictedByCount) + " by count, " +
+                       std::to_string(stats.evictedByAge) + " by age, " + std::to_string(stats.evictedByBudget) +
+                       " by byte budget");
+}
 
 void StompProtocol::runServerMessage() {
     
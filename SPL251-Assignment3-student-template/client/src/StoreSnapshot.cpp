@@ -0,0 +1,229 @@
+#include "../include/StoreSnapshot.h"
+#include "../include/EventsFileReader.h"
+#include "../include/SummaryWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+const char SnapshotMagic[8] = {'E', 'V', 'S', 'N', 'A', 'P', '\0', '\n'};
+const uint32_t SnapshotVersion = 1;
+
+template <typename T>
+void put(std::string &out, T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// appends one column of rows, field picks the value
+template <typename T, typename Field>
+void putColumn(std::string &out, const std::vector<EventRow> &rows, const Field &field) {
+    size_t start = out.size();
+    out.resize(start + rows.size() * sizeof(T));
+    char *column = &out[start];
+    for (const EventRow &row : rows) {
+        T value = field(row);
+        memcpy(column, &value, sizeof(T));
+        column += sizeof(T);
+    }
+}
+
+// bounds checked cursor over the mapping
+class SnapshotReader {
+private:
+    const char *cursor;
+    const char *end;
+
+public:
+    SnapshotReader(const char *data, size_t size) : cursor(data), end(data + size) {}
+
+    bool take(size_t size, const char *&data) {
+        if (static_cast<size_t>(end - cursor) < size) {
+            return false;
+        }
+        data = cursor;
+        cursor += size;
+        return true;
+    }
+
+    template <typename T>
+    bool read(T &value) {
+        const char *data;
+        if (!take(sizeof(T), data)) {
+            return false;
+        }
+        memcpy(&value, data, sizeof(T));
+        return true;
+    }
+
+    bool atEnd() const {
+        return cursor == end;
+    }
+};
+
+template <typename T>
+T columnValue(const char *column, size_t row) {
+    T value;
+    memcpy(&value, column + row * sizeof(T), sizeof(T));
+    return value;
+}
+
+} // namespace
+
+bool saveStoreSnapshot(const EventStore &store, const std::string &path, size_t &events) {
+    // every channel is copied out under its own lock, the encoding runs on the copies
+    std::vector<std::string> channels = store.channelNames();
+    std::vector<EventSnapshot> snapshots(channels.size());
+    std::vector<uint32_t> channelIds;
+    std::unordered_map<uint32_t, uint32_t> localIds;
+    std::vector<uint32_t> strings;
+    auto local = [&](uint32_t id) {
+        auto it = localIds.emplace(id, static_cast<uint32_t>(strings.size()));
+        if (it.second) {
+            strings.push_back(id);
+        }
+        return it.first->second;
+    };
+
+    events = 0;
+    for (size_t i = 0; i < channels.size(); i++) {
+        if (!store.snapshotChannel(channels[i], snapshots[i])) {
+            continue;
+        }
+        channelIds.push_back(local(internString(channels[i])));
+        for (EventRow &row : snapshots[i].rows) {
+            row.user = local(row.user);
+            row.city = local(row.city);
+            row.name = local(row.name);
+        }
+        events += snapshots[i].rows.size();
+    }
+
+    std::string out(SnapshotMagic, sizeof(SnapshotMagic));
+    put(out, SnapshotVersion);
+    put(out, static_cast<uint32_t>(strings.size()));
+    put(out, static_cast<uint32_t>(channelIds.size()));
+    for (uint32_t id : strings) {
+        const std::string &value = internedString(id);
+        put(out, static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+    size_t channel = 0;
+    for (const EventSnapshot &snapshot : snapshots) {
+        if (!snapshot.payload) {
+            continue;
+        }
+        const std::vector<EventRow> &rows = snapshot.rows;
+        uint64_t descriptionBytes = 0;
+        for (const EventRow &row : rows) {
+            descriptionBytes += row.descriptionLength;
+        }
+        put(out, channelIds[channel++]);
+        put(out, static_cast<uint32_t>(rows.size()));
+        put(out, descriptionBytes);
+        putColumn<int32_t>(out, rows, [](const EventRow &row) { return row.dateTime; });
+        putColumn<uint32_t>(out, rows, [](const EventRow &row) { return row.user; });
+        putColumn<uint32_t>(out, rows, [](const EventRow &row) { return row.city; });
+        putColumn<uint32_t>(out, rows, [](const EventRow &row) { return row.name; });
+        putColumn<uint32_t>(out, rows, [](const EventRow &row) { return row.descriptionLength; });
+        putColumn<uint8_t>(out, rows, [](const EventRow &row) { return row.flags; });
+        out.append((4 - rows.size() % 4) % 4, '\0');
+        for (const EventRow &row : rows) {
+            out.append(row.description, row.descriptionLength);
+        }
+    }
+
+    return SummaryWriter::replace(path, out) == SummaryWriter::Written;
+}
+
+bool restoreStoreSnapshot(EventStore &store, const std::string &path, size_t &events) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        return false;
+    }
+    SnapshotReader reader(file.data(), file.size());
+    const char *magic;
+    uint32_t version, stringCount, channelCount;
+    if (!reader.take(sizeof(SnapshotMagic), magic) || memcmp(magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 ||
+        !reader.read(version) || version != SnapshotVersion || !reader.read(stringCount) || !reader.read(channelCount)) {
+        return false;
+    }
+
+    // the whole file is decoded and checked before any string is interned or the store is
+    // touched, rows hold snapshot string indexes until then; every string takes at least 4
+    // bytes and every channel 16, which bounds the counts by the file size
+    if (stringCount > file.size() / sizeof(uint32_t) || channelCount > file.size() / 16) {
+        return false;
+    }
+    std::vector<std::pair<const char *, uint32_t>> strings;
+    strings.reserve(stringCount);
+    for (uint32_t i = 0; i < stringCount; i++) {
+        uint32_t length;
+        const char *data;
+        if (!reader.read(length) || !reader.take(length, data)) {
+            return false;
+        }
+        strings.emplace_back(data, length);
+    }
+
+    std::vector<std::pair<uint32_t, std::vector<EventRow>>> channels(channelCount);
+    events = 0;
+    for (auto &channel : channels) {
+        uint32_t rowCount;
+        uint64_t descriptionBytes;
+        const char *dateTimes, *users, *cities, *names, *lengths, *flags, *descriptions;
+        if (!reader.read(channel.first) || channel.first >= stringCount || !reader.read(rowCount) ||
+            !reader.read(descriptionBytes) || !reader.take(rowCount * sizeof(int32_t), dateTimes) ||
+            !reader.take(rowCount * sizeof(uint32_t), users) || !reader.take(rowCount * sizeof(uint32_t), cities) ||
+            !reader.take(rowCount * sizeof(uint32_t), names) || !reader.take(rowCount * sizeof(uint32_t), lengths) ||
+            !reader.take(rowCount + (4 - rowCount % 4) % 4, flags) ||
+            !reader.take(static_cast<size_t>(descriptionBytes), descriptions)) {
+            return false;
+        }
+        std::vector<EventRow> &rows = channel.second;
+        rows.reserve(rowCount);
+        uint64_t offset = 0;
+        for (uint32_t row = 0; row < rowCount; row++) {
+            uint32_t user = columnValue<uint32_t>(users, row);
+            uint32_t city = columnValue<uint32_t>(cities, row);
+            uint32_t name = columnValue<uint32_t>(names, row);
+            uint32_t length = columnValue<uint32_t>(lengths, row);
+            if (user >= stringCount || city >= stringCount || name >= stringCount || descriptionBytes - offset < length) {
+                return false;
+            }
+            rows.push_back(EventRow{columnValue<int32_t>(dateTimes, row), user, name, city,
+                                    static_cast<uint8_t>(flags[row]), descriptions + offset, length});
+            offset += length;
+        }
+        if (offset != descriptionBytes) {
+            return false;
+        }
+        events += rowCount;
+    }
+    if (!reader.atEnd()) {
+        return false;
+    }
+
+    // snapshot string indexes map onto this process's interned ids
+    std::vector<uint32_t> ids;
+    ids.reserve(stringCount);
+    for (const auto &value : strings) {
+        ids.push_back(internString(std::string(value.first, value.second)));
+    }
+    for (auto &channel : channels) {
+        for (EventRow &row : channel.second) {
+            row.user = ids[row.user];
+            row.name = ids[row.name];
+            row.city = ids[row.city];
+        }
+    }
+
+    // descriptions are copied out of the mapping into each channel's arena
+    store.clear();
+    for (const auto &channel : channels) {
+        store.add(internedString(ids[channel.first]), channel.second);
+    }
+    return true;
+}
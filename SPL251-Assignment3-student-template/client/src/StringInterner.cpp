@@ -0,0 +1,73 @@
+#include "../include/StringInterner.h"
+#include <stdexcept>
+
+using namespace std;
+
+StringInterner::StringInterner() : mutex(), ids(), chunks(), count(0)
+{
+    for (uint32_t i = 0; i < MaxChunks; i++) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+    intern("");
+}
+
+StringInterner::~StringInterner()
+{
+    for (uint32_t i = 0; i < MaxChunks; i++) {
+        delete[] chunks[i].load(std::memory_order_relaxed);
+    }
+}
+
+StringInterner &StringInterner::instance() {
+    static StringInterner interner;
+    return interner;
+}
+
+uint32_t StringInterner::intern(const std::string &value) {
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        auto it = ids.find(value);
+        if (it != ids.end()) {
+            return it->second;
+        }
+    }
+    std::lock_guard<std::shared_timed_mutex> lock(mutex);
+    // another thread may have added value since the shared lock was released
+    auto it = ids.find(value);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    uint32_t id = count;
+    uint32_t chunkIndex = id >> ChunkBits;
+    if (chunkIndex >= MaxChunks) {
+        throw std::length_error("string interner is full");
+    }
+    std::string *chunk = chunks[chunkIndex].load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+        chunk = new std::string[ChunkSize];
+        chunks[chunkIndex].store(chunk, std::memory_order_release);
+    }
+    chunk[id & (ChunkSize - 1)] = value;
+    ids.emplace(value, id);
+    count++;
+    return id;
+}
+
+bool StringInterner::find(const std::string &value, uint32_t &id) const {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex);
+    auto it = ids.find(value);
+    if (it == ids.end()) {
+        return false;
+    }
+    id = it->second;
+    return true;
+}
+
+const std::string &StringInterner::lookup(uint32_t id) const {
+    return chunks[id >> ChunkBits].load(std::memory_order_acquire)[id & (ChunkSize - 1)];
+}
+
+size_t StringInterner::size() const {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex);
+    return count;
+}
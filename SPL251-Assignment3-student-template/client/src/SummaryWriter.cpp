@@ -0,0 +1,157 @@
+#include "../include/SummaryWriter.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+
+using namespace std;
+
+SummaryWriter::SummaryWriter() : mutex(), ready(), jobs(), stopping(false), worker() {}
+
+SummaryWriter::~SummaryWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+namespace {
+
+bool pwriteAll(int fd, const char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, data, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += written;
+    }
+    return true;
+}
+
+bool preadAll(int fd, char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t bytesRead = ::pread(fd, data, size, offset);
+        if (bytesRead <= 0) {
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += bytesRead;
+        size -= static_cast<size_t>(bytesRead);
+        offset += bytesRead;
+    }
+    return true;
+}
+
+} // namespace
+
+SummaryWriter::Status SummaryWriter::write(const std::string &path, const std::string &contents) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return OpenFailed;
+    }
+    // reserve the blocks up front, filesystems without fallocate just skip it
+    if (!contents.empty()) {
+        ::posix_fallocate(fd, 0, static_cast<off_t>(contents.size()));
+    }
+    bool written = pwriteAll(fd, contents.data(), contents.size(), 0);
+    return ::close(fd) == 0 && written ? Written : WriteFailed;
+}
+
+SummaryWriter::Status SummaryWriter::update(const std::string &path, size_t headerSize, const std::string &header,
+                                            const std::string &tail) {
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return OpenFailed;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < headerSize) {
+        ::close(fd);
+        return WriteFailed;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (header.size() == headerSize) {
+        bool written = pwriteAll(fd, tail.data(), tail.size(), static_cast<off_t>(size)) &&
+                       pwriteAll(fd, header.data(), header.size(), 0);
+        return ::close(fd) == 0 && written ? Written : WriteFailed;
+    }
+
+    // a count gained a digit and everything after the header moves: build the new file
+    // beside the old one and rename it over, so readers see either version whole
+    std::string contents = header;
+    contents.resize(header.size() + size - headerSize);
+    bool bodyRead = size == headerSize ||
+                    preadAll(fd, &contents[header.size()], size - headerSize, static_cast<off_t>(headerSize));
+    ::close(fd);
+    if (!bodyRead) {
+        return WriteFailed;
+    }
+    contents += tail;
+    return replace(path, contents);
+}
+
+SummaryWriter::Status SummaryWriter::replace(const std::string &path, const std::string &contents) {
+    std::string temporaryPath = path + ".tmp";
+    int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return OpenFailed;
+    }
+    bool written = pwriteAll(fd, contents.data(), contents.size(), 0) && ::fsync(fd) == 0;
+    written = ::close(fd) == 0 && written && ::rename(temporaryPath.c_str(), path.c_str()) == 0;
+    if (!written) {
+        ::unlink(temporaryPath.c_str());
+        return WriteFailed;
+    }
+    // the rename itself is only durable once the directory entry is
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directoryFd >= 0) {
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    return Written;
+}
+
+void SummaryWriter::writeAsync(const std::string &path, std::string contents, const Completion &done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{path, std::move(contents), done});
+        if (!worker.joinable()) {
+            worker = std::thread(&SummaryWriter::run, this);
+        }
+    }
+    ready.notify_one();
+}
+
+void SummaryWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            return;
+        }
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        Status status = write(job.path, job.contents);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        if (job.done) {
+            job.done(job.path, status, elapsed);
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,118 @@
+#include "../include/TextIndex.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+void PostingList::add(uint32_t row) {
+    if (count > 0 && row == last) {
+        return;
+    }
+    uint32_t gap = count == 0 ? row : row - last;
+    while (gap >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(gap | 0x80));
+        gap >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(gap));
+    last = row;
+    count++;
+}
+
+size_t PostingList::size() const {
+    return count;
+}
+
+size_t PostingList::bytesUsed() const {
+    return bytes.capacity();
+}
+
+void PostingList::decode(std::vector<uint32_t> &rows) const {
+    rows.clear();
+    rows.reserve(count);
+    uint32_t row = 0;
+    for (size_t i = 0; i < bytes.size();) {
+        uint32_t gap = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = bytes[i++];
+            gap |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        row += gap;
+        rows.push_back(row);
+    }
+}
+
+void TextIndex::tokenize(const char *text, size_t size, std::vector<std::string> &words) {
+    words.clear();
+    std::string word;
+    forEachWord(text, size, word, [&words](const std::string &folded) { words.push_back(folded); });
+}
+
+void TextIndex::add(uint32_t row, const char *text, size_t size) {
+    forEachWord(text, size, word, [this, row](const std::string &folded) {
+        auto it = terms.find(folded);
+        if (it == terms.end()) {
+            it = terms.emplace(folded, PostingList()).first;
+        }
+        it->second.add(row);
+    });
+}
+
+std::vector<uint32_t> TextIndex::matchAll(const std::vector<std::string> &group) const {
+    std::vector<const PostingList *> lists;
+    std::vector<std::string> termWords;
+    for (const std::string &term : group) {
+        tokenize(term.data(), term.size(), termWords);
+        for (const std::string &word : termWords) {
+            auto it = terms.find(word);
+            if (it == terms.end()) {
+                return std::vector<uint32_t>();
+            }
+            lists.push_back(&it->second);
+        }
+    }
+    std::vector<uint32_t> rows;
+    if (lists.empty()) {
+        return rows;
+    }
+    // intersect starting from the shortest list
+    std::sort(lists.begin(), lists.end(), [](const PostingList *a, const PostingList *b) { return a->size() < b->size(); });
+    lists[0]->decode(rows);
+    std::vector<uint32_t> other, common;
+    for (size_t i = 1; i < lists.size() && !rows.empty(); i++) {
+        lists[i]->decode(other);
+        common.clear();
+        std::set_intersection(rows.begin(), rows.end(), other.begin(), other.end(), std::back_inserter(common));
+        rows.swap(common);
+    }
+    return rows;
+}
+
+std::vector<uint32_t> TextIndex::match(const TextQuery &query) const {
+    std::vector<uint32_t> rows, groupRows, merged;
+    for (const std::vector<std::string> &group : query) {
+        groupRows = matchAll(group);
+        merged.clear();
+        std::set_union(rows.begin(), rows.end(), groupRows.begin(), groupRows.end(), std::back_inserter(merged));
+        rows.swap(merged);
+    }
+    return rows;
+}
+
+size_t TextIndex::termCount() const {
+    return terms.size();
+}
+
+size_t TextIndex::bytesUsed() const {
+    size_t bytes = 0;
+    for (const auto &term : terms) {
+        bytes += term.first.capacity() + term.second.bytesUsed();
+    }
+    return bytes;
+}
+
+void TextIndex::clear() {
+    terms.clear();
+}
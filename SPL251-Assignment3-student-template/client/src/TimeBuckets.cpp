@@ -0,0 +1,104 @@
+#include "../include/TimeBuckets.h"
+#include "../include/event.h"
+
+using namespace std;
+
+namespace {
+
+const int Widths[TimeBuckets::ResolutionCount] = {60, 60 * 60, 24 * 60 * 60};
+// two hours of minutes, two days of hours, a quarter of days
+const size_t Capacities[TimeBuckets::ResolutionCount] = {120, 48, 90};
+
+size_t slotOf(int32_t index, size_t capacity) {
+    long long slot = static_cast<long long>(index) % static_cast<long long>(capacity);
+    return static_cast<size_t>(slot < 0 ? slot + static_cast<long long>(capacity) : slot);
+}
+
+} // namespace
+
+TimeBuckets::TimeBuckets() : rings(), newestDateTime(0), hasEvents(false) {
+    for (int resolution = 0; resolution < ResolutionCount; resolution++) {
+        rings[resolution].resize(Capacities[resolution]);
+    }
+}
+
+int TimeBuckets::width(Resolution resolution) {
+    return Widths[resolution];
+}
+
+size_t TimeBuckets::capacity(Resolution resolution) {
+    return Capacities[resolution];
+}
+
+// floor division, so buckets before the epoch line up too
+int32_t TimeBuckets::bucketIndex(int dateTime, Resolution resolution) {
+    int width = Widths[resolution];
+    return static_cast<int32_t>(dateTime / width - (dateTime % width < 0 ? 1 : 0));
+}
+
+void TimeBuckets::add(int dateTime, uint8_t flags) {
+    if (!hasEvents || dateTime > newestDateTime) {
+        newestDateTime = dateTime;
+    }
+    hasEvents = true;
+    for (int resolution = 0; resolution < ResolutionCount; resolution++) {
+        int32_t index = bucketIndex(dateTime, static_cast<Resolution>(resolution));
+        Bucket &bucket = rings[resolution][slotOf(index, Capacities[resolution])];
+        if (bucket.index > index) {
+            // the slot already moved on to a newer bucket
+            continue;
+        }
+        if (bucket.index < index) {
+            bucket = Bucket();
+            bucket.index = index;
+        }
+        bucket.events++;
+        bucket.active += (flags & Event::ActiveFlag) ? 1 : 0;
+    }
+}
+
+void TimeBuckets::merge(const TimeBuckets &other) {
+    if (!other.hasEvents) {
+        return;
+    }
+    if (!hasEvents || other.newestDateTime > newestDateTime) {
+        newestDateTime = other.newestDateTime;
+    }
+    hasEvents = true;
+    for (int resolution = 0; resolution < ResolutionCount; resolution++) {
+        // both rings share the slot of every index, each slot keeps the newer bucket
+        for (size_t slot = 0; slot < Capacities[resolution]; slot++) {
+            Bucket &bucket = rings[resolution][slot];
+            const Bucket &added = other.rings[resolution][slot];
+            if (bucket.index < added.index) {
+                bucket = added;
+            } else if (bucket.index == added.index) {
+                bucket.events += added.events;
+                bucket.active += added.active;
+            }
+        }
+    }
+}
+
+bool TimeBuckets::empty() const {
+    return !hasEvents;
+}
+
+int TimeBuckets::newest() const {
+    return newestDateTime;
+}
+
+TrendCounts TimeBuckets::window(Resolution resolution, size_t count, int end) const {
+    TrendCounts counts;
+    size_t capacity = Capacities[resolution];
+    int32_t last = bucketIndex(end, resolution);
+    for (size_t i = 0; i < count && i < capacity; i++) {
+        int32_t index = static_cast<int32_t>(last - static_cast<int32_t>(i));
+        const Bucket &bucket = rings[resolution][slotOf(index, capacity)];
+        if (bucket.index == index) {
+            counts.events += bucket.events;
+            counts.active += bucket.active;
+        }
+    }
+    return counts;
+}
@@ -0,0 +1,196 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <functional>
+#include "../include/StompProtocol.h"
+#include "../include/CreateFrames.h"
+#include "../include/event.h"
+
+using namespace std;
+
+/**
+* Throughput benchmark for the frame codecs.
+* Usage: StompBenchmark [output.json] [iterations]
+* Every codec path runs over generated frames of varying header count and body size,
+* the results (ns/frame, bytes/sec, allocations/frame) are written as JSON.
+*/
+
+// Every heap allocation of the process goes through here so each case can report allocations per frame
+static std::atomic<unsigned long> allocationCount(0);
+
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+struct BenchmarkResult {
+    string codec;
+    int headerCount;
+    size_t bodySize;
+    size_t frameBytes;
+    double nsPerFrame;
+    double bytesPerSecond;
+    double allocationsPerFrame;
+};
+
+// Builds an event body in the same layout reportEvents sends
+static string makeEventBody(size_t descriptionSize) {
+    ostringstream body;
+    body << "user:bench\n"
+         << "channel name:police\n"
+         << "city:Liberty City\n"
+         << "event name:Grand Theft Auto\n"
+         << "date time:1734961200\n"
+         << "description:" << string(descriptionSize, 'd') << "\n"
+         << "general information:\n"
+         << "\tactive:true\n"
+         << "\tforces_arrival_at_scene:false\n";
+    return body.str();
+}
+
+// Builds a MESSAGE frame as the server delivers it, padded with extra headers
+static string makeMessageFrame(int headerCount, const string &body) {
+    ostringstream frame;
+    frame << "MESSAGE\n"
+          << "subscription:1\n"
+          << "message-id:42\n"
+          << "user:bench\n"
+          << "destination:/police\n";
+    for (int i = 0; i < headerCount; i++) {
+        frame << "x-header-" << i << ":value-" << i << "\n";
+    }
+    frame << "\n" << body << "\n";
+    return frame.str();
+}
+
+static volatile size_t sink = 0;
+
+static BenchmarkResult runCase(const string &codec, int headerCount, size_t bodySize, size_t frameBytes,
+                               int iterations, const function<size_t()> &body) {
+    // warm up caches and lazily initialized state
+    for (int i = 0; i < iterations / 10 + 1; i++) {
+        sink = sink + body();
+    }
+
+    unsigned long allocationsBefore = allocationCount.load();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        sink = sink + body();
+    }
+    auto end = chrono::steady_clock::now();
+    unsigned long allocations = allocationCount.load() - allocationsBefore;
+
+    double totalNs = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+    double bytesPerSecond = totalNs > 0 ? frameBytes * static_cast<double>(iterations) * 1e9 / totalNs : 0;
+    return BenchmarkResult{codec, headerCount, bodySize, frameBytes, totalNs / iterations, bytesPerSecond,
+                           static_cast<double>(allocations) / iterations};
+}
+
+static void writeJson(const string &path, const vector<BenchmarkResult> &results, int iterations) {
+    ofstream out(path);
+    if (!out.is_open()) {
+        cerr << "[ERROR] Failed to open benchmark output: " << path << endl;
+        return;
+    }
+    out << "{\n  \"iterations\": " << iterations << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &r = results[i];
+        out << "    {\"codec\": \"" << r.codec << "\""
+            << ", \"headers\": " << r.headerCount
+            << ", \"body_bytes\": " << r.bodySize
+            << ", \"frame_bytes\": " << r.frameBytes
+            << ", \"ns_per_frame\": " << r.nsPerFrame
+            << ", \"bytes_per_sec\": " << r.bytesPerSecond
+            << ", \"allocs_per_frame\": " << r.allocationsPerFrame << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char *argv[]) {
+    string outputPath = argc > 1 ? argv[1] : "benchmark.json";
+    int iterations = argc > 2 ? atoi(argv[2]) : 20000;
+    if (iterations <= 0) {
+        cerr << "Usage: " << argv[0] << " [output.json] [iterations]" << endl;
+        return -1;
+    }
+
+    const vector<int> headerCounts = {0, 8, 32};
+    const vector<size_t> bodySizes = {64, 1024, 16384};
+
+    CreateFrames frameCreator;
+    StompProtocol protocol("127.0.0.1", 0);
+    vector<BenchmarkResult> results;
+
+    for (int headerCount : headerCounts) {
+        for (size_t bodySize : bodySizes) {
+            const string body = makeEventBody(bodySize);
+            const string frame = makeMessageFrame(headerCount, body);
+
+            results.push_back(runCase("CreateFrames::parseMessage", headerCount, bodySize, frame.size(), iterations,
+                [&]() { return frameCreator.parseMessage(frame).size(); }));
+
+            protocol.setLazyEventParsing(false);
+            results.push_back(runCase("StompProtocol::parseEvent", headerCount, bodySize, frame.size(), iterations,
+                [&]() { return static_cast<size_t>(protocol.parseEvent(frame).get_date_time()); }));
+
+            protocol.setLazyEventParsing(true);
+            results.push_back(runCase("StompProtocol::parseEvent(lazy)", headerCount, bodySize, frame.size(), iterations,
+                [&]() { return static_cast<size_t>(protocol.parseEvent(frame).get_date_time()); }));
+
+            results.push_back(runCase("Event(frame_body)", headerCount, bodySize, body.size(), iterations,
+                [&]() { return Event(body).get_name().size(); }));
+        }
+    }
+
+    // encoders: only the SEND frame depends on the body size
+    results.push_back(runCase("CreateFrames::createConnectFrame", 0, 0,
+        frameCreator.createConnectFrame("stomp.cs.bgu.ac.il", "bench", "pass").size(), iterations,
+        [&]() { return frameCreator.createConnectFrame("stomp.cs.bgu.ac.il", "bench", "pass").size(); }));
+    results.push_back(runCase("CreateFrames::createSubscribeFrame", 0, 0,
+        frameCreator.createSubscribeFrame("/police", "1", "2").size(), iterations,
+        [&]() { return frameCreator.createSubscribeFrame("/police", "1", "2").size(); }));
+    results.push_back(runCase("CreateFrames::createUnsubscribeFrame", 0, 0,
+        frameCreator.createUnsubscribeFrame("1", "2").size(), iterations,
+        [&]() { return frameCreator.createUnsubscribeFrame("1", "2").size(); }));
+    results.push_back(runCase("CreateFrames::createDisconnectFrame", 0, 0,
+        frameCreator.createDisconnectFrame("2").size(), iterations,
+        [&]() { return frameCreator.createDisconnectFrame("2").size(); }));
+    for (size_t bodySize : bodySizes) {
+        const string body = makeEventBody(bodySize);
+        results.push_back(runCase("CreateFrames::createSendFrame", 0, bodySize,
+            frameCreator.createSendFrame("/police", body, "2").size(), iterations,
+            [&]() { return frameCreator.createSendFrame("/police", body, "2").size(); }));
+    }
+
+    // summary timestamps: consecutive events of one day share the cached date prefix
+    time_t epoch = 1700000000;
+    results.push_back(runCase("StompProtocol::epochToDate", 0, 0, StompProtocol::epochToDate(epoch).size(), iterations,
+        [&]() { return StompProtocol::epochToDate(epoch += 13).size(); }));
+
+    writeJson(outputPath, results, iterations);
+    for (const BenchmarkResult &r : results) {
+        cout << r.codec << " headers=" << r.headerCount << " body=" << r.bodySize
+             << " " << r.nsPerFrame << " ns/frame " << r.allocationsPerFrame << " allocs/frame" << endl;
+    }
+    cout << "[INFO] Benchmark results written to: " << outputPath << endl;
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "../include/event.h"
 #include "../include/json.hpp"
+#include "../include/EventsFileReader.h"
+#include "../include/StringInterner.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -22,13 +24,69 @@ void split_str(const std::string &s, char delimiter, std::vector<std::string> &t
     }
 }
 
+GeneralInfoValue GeneralInfoValue::parse(const std::string &value) {
+    if (value == "true" || value == "false") {
+        return GeneralInfoValue(BoolValue, value == "true", 0, "");
+    }
+    // only canonical integers, so toString() gives back exactly the same text
+    size_t digits = (!value.empty() && value[0] == '-') ? 1 : 0;
+    bool canonical = value.size() > digits && value.size() - digits <= 18 &&
+                     (value[digits] != '0' || value.size() == digits + 1) && value != "-0";
+    for (size_t i = digits; canonical && i < value.size(); i++) {
+        canonical = value[i] >= '0' && value[i] <= '9';
+    }
+    if (canonical) {
+        return GeneralInfoValue(IntegerValue, false, std::stoll(value), "");
+    }
+    return GeneralInfoValue(StringValue, false, 0, value);
+}
+
+std::string GeneralInfoValue::toString() const {
+    switch (type) {
+    case BoolValue:
+        return boolean ? "true" : "false";
+    case IntegerValue:
+        return std::to_string(integer);
+    default:
+        return text;
+    }
+}
+
+static uint32_t activeKey() {
+    static const uint32_t key = internString("active");
+    return key;
+}
+
+static uint32_t forcesArrivalKey() {
+    static const uint32_t key = internString("forces_arrival_at_scene");
+    return key;
+}
+
 // Event Class Implementation
 
 Event::Event(std::string channel_name, std::string city, std::string name, int date_time,
              std::string description, std::map<std::string, std::string> general_information)
-    : channel_name(channel_name), city(city), name(name),
-      date_time(date_time), description(description), general_information(general_information), eventOwnerUser("")
+    : channel_name(internString(channel_name)), city(internString(city)), name(name),
+      date_time(date_time), description(description), general_information(), flags(0), eventOwnerUser(StringInterner::EmptyId),
+      raw_body(), city_span{0, 0}, description_span{0, 0}, general_information_span{0, 0}, pending(0)
 {
+    for (const auto &info : general_information) {
+        this->general_information[internString(info.first)] = GeneralInfoValue::parse(info.second);
+    }
+    computeFlags();
+}
+
+void Event::computeFlags() {
+    flags = 0;
+    auto active = general_information.find(activeKey());
+    if (active != general_information.end() && active->second.type == GeneralInfoValue::BoolValue && active->second.boolean) {
+        flags |= ActiveFlag;
+    }
+    auto forcesArrival = general_information.find(forcesArrivalKey());
+    if (forcesArrival != general_information.end() && forcesArrival->second.type == GeneralInfoValue::BoolValue &&
+        forcesArrival->second.boolean) {
+        flags |= ForcesArrivalFlag;
+    }
 }
 
 Event::~Event()
@@ -36,20 +94,38 @@ Event::~Event()
 }
 
 void Event::setEventOwnerUser(std::string setEventOwnerUser) {
-    eventOwnerUser = setEventOwnerUser;
+    eventOwnerUser = internString(setEventOwnerUser);
+}
+
+void Event::setChannelName(const std::string &channel_name) {
+    this->channel_name = internString(channel_name);
 }
 
 const std::string &Event::getEventOwnerUser() const {
-    return eventOwnerUser;
+    return internedString(eventOwnerUser);
     
 }
 
 const std::string &Event::get_channel_name() const {
-    return this->channel_name;
+    return internedString(this->channel_name);
 }
 
 const std::string &Event::get_city() const {
-    return this->city;
+    decodeCity();
+    return internedString(this->city);
+}
+
+uint32_t Event::getEventOwnerUserId() const {
+    return eventOwnerUser;
+}
+
+uint32_t Event::get_channel_name_id() const {
+    return channel_name;
+}
+
+uint32_t Event::get_city_id() const {
+    decodeCity();
+    return city;
 }
 
 const std::string &Event::get_name() const {
@@ -60,22 +136,43 @@ int Event::get_date_time() const {
     return this->date_time;
 }
 
-const std::map<std::string, std::string> &Event::get_general_information() const {
-    return this->general_information;
+std::map<std::string, std::string> Event::get_general_information() const {
+    decodeGeneralInformation();
+    std::map<std::string, std::string> information;
+    for (const auto &info : general_information) {
+        information[internedString(info.first)] = info.second.toString();
+    }
+    return information;
+}
+
+const std::map<uint32_t, GeneralInfoValue> &Event::get_typed_general_information() const {
+    decodeGeneralInformation();
+    return general_information;
 }
 
 const std::string &Event::get_description() const {
+    decodeDescription();
     return this->description;
 }
 
+const char *Event::get_description_data() const {
+    return (pending & PendingDescription) ? raw_body.data() + description_span.offset : description.data();
+}
+
+size_t Event::get_description_size() const {
+    return (pending & PendingDescription) ? description_span.length : description.size();
+}
+
 bool Event::isActive() const {
-    auto it = general_information.find("active");
-    return it != general_information.end() && it->second == "true";
+    return (flags & ActiveFlag) != 0;
 }
 
 bool Event::forcesArrivalAtScene() const {
-    auto it = general_information.find("forces_arrival_at_scene");
-    return it != general_information.end() && it->second == "true";
+    return (flags & ForcesArrivalFlag) != 0;
+}
+
+uint8_t Event::get_flags() const {
+    return flags;
 }
 
 int Event::getCurrentTime() const {
@@ -89,15 +186,15 @@ int Event::getCurrentTime() const {
 std::string Event::toString() const {
     std::ostringstream out;
 
-    out << "user:" << eventOwnerUser << "\n";
-    out << "channel name:" << channel_name << "\n";
-    out << "city:" << city << "\n";
+    out << "user:" << getEventOwnerUser() << "\n";
+    out << "channel name:" << get_channel_name() << "\n";
+    out << "city:" << get_city() << "\n";
     out << "event name:" << name << "\n";
     out << "date time:" << date_time << "\n";
-    out << "description:" << description << "\n";
+    out << "description:" << get_description() << "\n";
 
     out << "general information:" << "\n";
-    for (const auto& [key, value] : general_information) {
+    for (const auto& [key, value] : get_general_information()) {
         out << "\t" << key << ":" << value << "\n";
     }
 
@@ -105,12 +202,13 @@ std::string Event::toString() const {
 }
 
 Event::Event(const std::string &frame_body)
-    : channel_name(""), city(""), name(""), date_time(0), description(""), general_information(), eventOwnerUser("")
+    : channel_name(StringInterner::EmptyId), city(StringInterner::EmptyId), name(""), date_time(0), description(""), general_information(), flags(0), eventOwnerUser(StringInterner::EmptyId),
+      raw_body(), city_span{0, 0}, description_span{0, 0}, general_information_span{0, 0}, pending(0)
 {
     stringstream ss(frame_body);
     string line;
     string eventDescription;
-    map<string, string> general_information_from_string;
+    map<uint32_t, GeneralInfoValue> general_information_from_string;
     bool inGeneralInformation = false;
     while(getline(ss,line,'\n')) {
         vector<string> lineArgs;
@@ -122,13 +220,13 @@ Event::Event(const std::string &frame_body)
                 val = lineArgs.at(1);
             }
             if(key == "user") {
-                eventOwnerUser = val;
+                eventOwnerUser = internString(val);
             }
             if(key == "channel name") {
-                channel_name = val;
+                channel_name = internString(val);
             }
             if(key == "city") {
-                city = val;
+                city = internString(val);
             }
             else if(key == "event name") {
                 name = val;
@@ -148,40 +246,111 @@ Event::Event(const std::string &frame_body)
             }
 
             if(inGeneralInformation) {
-                general_information_from_string[key.substr(1)] = val;
+                general_information_from_string[internString(key.substr(1))] = GeneralInfoValue::parse(val);
             }
         }
     }
     general_information = general_information_from_string;
+    computeFlags();
 }
 
-// Helper function to parse events from a JSON file
-names_and_events parseEventsFile(std::string json_path, const std::string& eventOwnerUser)
+Event::Event(std::string received_frame, const std::string &channel_name, int date_time, bool lazy)
+    : channel_name(internString(channel_name)), city(StringInterner::EmptyId), name(), date_time(date_time), description(),
+      general_information(), flags(0), eventOwnerUser(StringInterner::EmptyId), raw_body(std::move(received_frame)),
+      city_span{0, 0}, description_span{0, 0}, general_information_span{0, 0},
+      pending(PendingCity | PendingDescription | PendingGeneralInformation)
 {
-    std::ifstream f(json_path);
-    json data = json::parse(f);
+    // the rest of the line after the first occurrence of field, empty if there is none
+    auto valueSpan = [this](const char *field) {
+        size_t position = raw_body.find(field);
+        if (position == string::npos) {
+            return FieldSpan{0, 0};
+        }
+        size_t start = position + strlen(field);
+        size_t end = raw_body.find('\n', start);
+        return FieldSpan{start, (end == string::npos ? raw_body.size() : end) - start};
+    };
+    city_span = valueSpan("city:");
+    name = spanText(valueSpan("event name:"));
+    description_span = valueSpan("description:");
+    general_information_span = valueSpan("general information:");
+
+    // the flags decodeGeneralInformation's values will give, without building them
+    bool active = raw_body.find("active:true") != string::npos;
+    bool forcesArrival = raw_body.find("forces_arrival_at_scene:true") != string::npos;
+    string key, value;
+    if (extraGeneralInformation(key, value) && (key == "active" || key == "forces_arrival_at_scene")) {
+        GeneralInfoValue parsed = GeneralInfoValue::parse(value);
+        (key == "active" ? active : forcesArrival) = parsed.type == GeneralInfoValue::BoolValue && parsed.boolean;
+    }
+    flags = static_cast<uint8_t>((active ? ActiveFlag : 0) | (forcesArrival ? ForcesArrivalFlag : 0));
 
-    std::string channel_name = data["channel_name"];
+    if (!lazy) {
+        decodeCity();
+        decodeDescription();
+        decodeGeneralInformation();
+        raw_body = string();
+    }
+}
 
-    // run over all the events and convert them to Event objects
-    std::vector<Event> events;
-    for (auto &event : data["events"]) {
-        std::string name = event["event_name"];
-        std::string city = event["city"];
-        int date_time = event["date_time"];
-        std::string description = event["description"];
-        std::map<std::string, std::string> general_information;
-        for (auto &update : event["general_information"].items()) {
-            if (update.value().is_string())
-                general_information[update.key()] = update.value();
-            else
-                general_information[update.key()] = update.value().dump();
-        }
+std::string Event::spanText(const FieldSpan &span) const {
+    return raw_body.substr(span.offset, span.length);
+}
+
+bool Event::extraGeneralInformation(std::string &key, std::string &value) const {
+    string line = spanText(general_information_span);
+    size_t separator = line.find(':');
+    if (separator == string::npos) {
+        return false;
+    }
+    key = line.substr(0, separator);
+    value = line.substr(separator + 1);
+    return true;
+}
+
+void Event::decodeCity() const {
+    if (pending & PendingCity) {
+        city = internString(spanText(city_span));
+        pending &= ~PendingCity;
+    }
+}
 
-        events.push_back(Event(channel_name, city, name, date_time, description, general_information));
-        events.back().setEventOwnerUser(eventOwnerUser); // Set user after creation
+void Event::decodeDescription() const {
+    if (pending & PendingDescription) {
+        description = spanText(description_span);
+        pending &= ~PendingDescription;
+    }
+}
 
+void Event::decodeGeneralInformation() const {
+    if (!(pending & PendingGeneralInformation)) {
+        return;
     }
+    general_information[activeKey()] =
+        GeneralInfoValue(GeneralInfoValue::BoolValue, raw_body.find("active:true") != string::npos, 0, "");
+    general_information[forcesArrivalKey()] =
+        GeneralInfoValue(GeneralInfoValue::BoolValue, raw_body.find("forces_arrival_at_scene:true") != string::npos, 0, "");
+    string key, value;
+    if (extraGeneralInformation(key, value)) {
+        general_information[internString(key)] = GeneralInfoValue::parse(value);
+    }
+    pending &= ~PendingGeneralInformation;
+}
+
+std::string parseEventsFile(const std::string &json_path, const std::string &eventOwnerUser,
+                            const std::function<void(Event &)> &consumer)
+{
+    EventsFile file(json_path, eventOwnerUser);
+    return file.read([&consumer](Event &event, size_t) { consumer(event); });
+}
+
+// Helper function to parse events from a JSON file
+names_and_events parseEventsFile(std::string json_path, const std::string& eventOwnerUser)
+{
+    std::vector<Event> events;
+    std::string channel_name = parseEventsFile(json_path, eventOwnerUser, [&events](Event &event) {
+        events.push_back(event);
+    });
 
     names_and_events events_and_names{channel_name, events};
     return events_and_names;